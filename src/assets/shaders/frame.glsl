@@ -0,0 +1,9 @@
+// per frame camera state, see FrameUniforms
+layout (std140) uniform Frame
+{
+    mat4 view;
+    mat4 projection;
+    mat4 view_projection;
+    vec4 camera_position;
+    float time;
+};
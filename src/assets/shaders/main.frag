@@ -1,12 +1,27 @@
 #version 330 core
 
-uniform sampler2D texture_diffuse1;
+// with TEXTURE_ARRAYS every texture is a layer of an array shared by all materials of a group (see texture_array.h)
+struct Material
+{
+#ifdef TEXTURE_ARRAYS
+    sampler2DArray texture_diffuse_array1;
+#else
+    sampler2D texture_diffuse1;
+#endif
+};
+
+uniform Material material;
 
 in vec2 texture_coords;
+flat in float texture_layer;
 
 out vec4 fragment_color;
 
 void main()
 {
-    fragment_color = texture(texture_diffuse1, texture_coords);
+#ifdef TEXTURE_ARRAYS
+    fragment_color = texture(material.texture_diffuse_array1, vec3(texture_coords, texture_layer));
+#else
+    fragment_color = texture(material.texture_diffuse1, texture_coords);
+#endif
 }
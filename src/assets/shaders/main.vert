@@ -1,17 +1,55 @@
 #version 330 core
 
+#include "frame.glsl"
+
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+// dequantization of compact vertices, the defaults leave float vertices untouched
+uniform vec3 position_offset = vec3(0.0);
+uniform vec3 position_scale = vec3(1.0);
+
+// the switches are uniforms in the generic program and constants in variants built with the matching
+// define (see ShaderLibrary), so those have the other branch compiled out
+#ifdef COMPACT_VERTICES
+const bool octahedral_normals = true;
+#else
+uniform bool octahedral_normals = false;
+#endif
+// instanced draws take the model matrix from instance_model instead of the uniform
+#ifdef INSTANCED
+const bool instanced = true;
+#else
+uniform bool instanced = false;
+#endif
 
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in mat4 instance_model;
+// layer of the material's texture arrays, see TEXTURE_LAYER_ATTRIBUTE_LOCATION
+layout (location = 7) in float aTextureLayer;
 
 out vec2 texture_coords;
+out vec3 normal;
+flat out float texture_layer;
+
+vec3 octahedral_decode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
 
 void main()
 {
+    vec3 position = position_offset + position_scale * aPos;
+    vec3 object_normal = octahedral_normals ? octahedral_decode(aNormal.xy) : aNormal;
+    mat4 world = instanced ? instance_model : model;
+
     texture_coords = aTexCoords;
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    texture_layer = aTextureLayer;
+    normal = mat3(world) * object_normal;
+    gl_Position = view_projection * world * vec4(position, 1.0);
 }
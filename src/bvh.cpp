@@ -0,0 +1,422 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+
+#include "thread_pool.h"
+
+namespace
+{
+    const unsigned int bin_count = 16;
+    const unsigned int max_leaf_size = 8;
+    // subtrees with fewer items are built on the current thread
+    const unsigned int parallel_build_size = 4096;
+    // past this depth nodes are split at the median instead, which bounds the depth and with it the traversal stacks
+    const unsigned int max_sah_depth = 32;
+    const unsigned int max_stack_size = 96;
+
+    float surface_area(const glm::vec3 &min, const glm::vec3 &max)
+    {
+        glm::vec3 extent = glm::max(max - min, glm::vec3(0.0f));
+        return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+    }
+
+    // distance along the ray to where it enters the box, infinity if it misses or the entry lies beyond max_distance
+    float ray_box(const glm::vec3 &origin, const glm::vec3 &inverse_direction, const glm::vec3 &min, const glm::vec3 &max, float max_distance)
+    {
+        glm::vec3 t0 = (min - origin) * inverse_direction;
+        glm::vec3 t1 = (max - origin) * inverse_direction;
+        glm::vec3 near = glm::min(t0, t1);
+        glm::vec3 far = glm::max(t0, t1);
+        float enter = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+        float exit = std::min(std::min(far.x, far.y), std::min(far.z, max_distance));
+        return enter <= exit ? enter : std::numeric_limits<float>::infinity();
+    }
+}
+
+BoundingBox transform_box(const BoundingBox &box, const glm::mat4 &matrix)
+{
+    // Arvo: the extent of the transformed box is the absolute matrix applied to the extent
+    glm::vec3 center = glm::vec3(matrix * glm::vec4((box.min + box.max) * 0.5f, 1.0f));
+    glm::vec3 extent = (box.max - box.min) * 0.5f;
+    glm::mat3 absolute(glm::abs(glm::vec3(matrix[0])), glm::abs(glm::vec3(matrix[1])), glm::abs(glm::vec3(matrix[2])));
+    glm::vec3 transformed_extent = absolute * extent;
+    return {center - transformed_extent, center + transformed_extent};
+}
+
+struct Bvh::Builder
+{
+    Bvh &bvh;
+    std::vector<glm::vec3> centroids;
+    std::atomic<unsigned int> node_count{1};
+
+    Builder(Bvh &bvh) : bvh(bvh) {}
+
+    void build_node(unsigned int node_index, unsigned int first, unsigned int count, unsigned int depth)
+    {
+        Node &node = bvh.nodes[node_index];
+        node.min = glm::vec3(std::numeric_limits<float>::max());
+        node.max = glm::vec3(-std::numeric_limits<float>::max());
+        glm::vec3 centroid_min = node.min;
+        glm::vec3 centroid_max = node.max;
+        for (unsigned int i = first; i < first + count; i++)
+        {
+            unsigned int item = bvh.order[i];
+            node.min = glm::min(node.min, bvh.boxes[item].min);
+            node.max = glm::max(node.max, bvh.boxes[item].max);
+            centroid_min = glm::min(centroid_min, centroids[item]);
+            centroid_max = glm::max(centroid_max, centroids[item]);
+        }
+
+        unsigned int split = depth < max_sah_depth ? find_split(node, first, count, centroid_min, centroid_max)
+                                                   : median_split(first, count, centroid_min, centroid_max);
+        if (split == first || split == first + count)
+        {
+            node.first = first;
+            node.count = count;
+            return;
+        }
+
+        unsigned int left = node_count.fetch_add(2);
+        node.first = left;
+        node.count = 0;
+
+        unsigned int left_count = split - first;
+        unsigned int right_count = count - left_count;
+        if (count >= parallel_build_size)
+        {
+            ThreadPool::shared().parallel_for(2, [&](size_t child)
+                                              {
+                                                  if (child == 0)
+                                                  {
+                                                      build_node(left, first, left_count, depth + 1);
+                                                  }
+                                                  else
+                                                  {
+                                                      build_node(left + 1, split, right_count, depth + 1);
+                                                  }
+                                              });
+        }
+        else
+        {
+            build_node(left, first, left_count, depth + 1);
+            build_node(left + 1, split, right_count, depth + 1);
+        }
+    }
+
+    unsigned int median_split(unsigned int first, unsigned int count, const glm::vec3 &centroid_min, const glm::vec3 &centroid_max)
+    {
+        if (count <= max_leaf_size)
+        {
+            return first;
+        }
+        glm::vec3 extent = centroid_max - centroid_min;
+        int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+        unsigned int *items = bvh.order.data() + first;
+        std::nth_element(items, items + count / 2, items + count, [&](unsigned int a, unsigned int b)
+                         { return centroids[a][axis] < centroids[b][axis]; });
+        return first + count / 2;
+    }
+
+    // partitions the node's items and returns where the right child starts, first or first + count to make a leaf
+    unsigned int find_split(const Node &node, unsigned int first, unsigned int count, const glm::vec3 &centroid_min, const glm::vec3 &centroid_max)
+    {
+        if (count <= 1)
+        {
+            return first;
+        }
+
+        glm::vec3 extent = centroid_max - centroid_min;
+        int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+        unsigned int *items = bvh.order.data() + first;
+        if (extent[axis] <= 0.0f)
+        {
+            // every centroid in the same place, no plane separates them. Split by count if the leaf would get too big.
+            return count <= max_leaf_size ? first : first + count / 2;
+        }
+
+        // bin the centroids along the widest axis
+        struct Bin
+        {
+            glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+            glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+            unsigned int count = 0;
+        };
+        Bin bins[bin_count];
+        float scale = bin_count / extent[axis];
+        auto bin_of = [&](unsigned int item)
+        {
+            return std::min(static_cast<unsigned int>((centroids[item][axis] - centroid_min[axis]) * scale), bin_count - 1);
+        };
+        for (unsigned int i = 0; i < count; i++)
+        {
+            Bin &bin = bins[bin_of(items[i])];
+            bin.min = glm::min(bin.min, bvh.boxes[items[i]].min);
+            bin.max = glm::max(bin.max, bvh.boxes[items[i]].max);
+            bin.count++;
+        }
+
+        // sweep from the right to get the cost of everything right of each plane, then from the left to find the cheapest plane
+        float right_cost[bin_count];
+        Bin right;
+        for (unsigned int b = bin_count - 1; b > 0; b--)
+        {
+            right.min = glm::min(right.min, bins[b].min);
+            right.max = glm::max(right.max, bins[b].max);
+            right.count += bins[b].count;
+            right_cost[b] = right.count > 0 ? surface_area(right.min, right.max) * right.count : 0.0f;
+        }
+
+        float best_cost = std::numeric_limits<float>::max();
+        unsigned int best_plane = 0;
+        Bin left;
+        for (unsigned int b = 0; b + 1 < bin_count; b++)
+        {
+            left.min = glm::min(left.min, bins[b].min);
+            left.max = glm::max(left.max, bins[b].max);
+            left.count += bins[b].count;
+            if (left.count == 0 || left.count == count)
+            {
+                continue;
+            }
+            float cost = surface_area(left.min, left.max) * left.count + right_cost[b + 1];
+            if (cost < best_cost)
+            {
+                best_cost = cost;
+                best_plane = b + 1;
+            }
+        }
+
+        // costs relative to intersecting one item, with one unit for traversing the extra node
+        float leaf_cost = static_cast<float>(count);
+        float split_cost = 1.0f + best_cost / surface_area(node.min, node.max);
+        if (count <= max_leaf_size && leaf_cost <= split_cost)
+        {
+            return first;
+        }
+
+        unsigned int *middle = std::partition(items, items + count, [&](unsigned int item)
+                                              { return bin_of(item) < best_plane; });
+        return first + static_cast<unsigned int>(middle - items);
+    }
+};
+
+void Bvh::build(std::vector<BoundingBox> boxes)
+{
+    this->boxes = std::move(boxes);
+    dirty = false;
+    order.resize(this->boxes.size());
+    for (unsigned int i = 0; i < order.size(); i++)
+    {
+        order[i] = i;
+    }
+    nodes.clear();
+    if (this->boxes.empty())
+    {
+        return;
+    }
+
+    Builder builder(*this);
+    builder.centroids.resize(this->boxes.size());
+    for (size_t i = 0; i < this->boxes.size(); i++)
+    {
+        builder.centroids[i] = (this->boxes[i].min + this->boxes[i].max) * 0.5f;
+    }
+
+    // a binary tree over n items never has more than 2n - 1 nodes
+    nodes.resize(2 * this->boxes.size() - 1);
+    builder.build_node(0, 0, static_cast<unsigned int>(this->boxes.size()), 0);
+    nodes.resize(builder.node_count);
+}
+
+void Bvh::clear()
+{
+    boxes.clear();
+    order.clear();
+    nodes.clear();
+    dirty = false;
+}
+
+void Bvh::update(unsigned int item, const BoundingBox &box)
+{
+    boxes[item] = box;
+    dirty = true;
+}
+
+void Bvh::refit()
+{
+    if (!dirty)
+    {
+        return;
+    }
+    dirty = false;
+
+    // children are always allocated after their parent, so walking backwards visits them first
+    for (size_t i = nodes.size(); i-- > 0;)
+    {
+        Node &node = nodes[i];
+        if (node.count > 0)
+        {
+            node.min = boxes[order[node.first]].min;
+            node.max = boxes[order[node.first]].max;
+            for (unsigned int k = node.first + 1; k < node.first + node.count; k++)
+            {
+                node.min = glm::min(node.min, boxes[order[k]].min);
+                node.max = glm::max(node.max, boxes[order[k]].max);
+            }
+        }
+        else
+        {
+            node.min = glm::min(nodes[node.first].min, nodes[node.first + 1].min);
+            node.max = glm::max(nodes[node.first].max, nodes[node.first + 1].max);
+        }
+    }
+}
+
+void Bvh::query_frustum(const Frustum &frustum, std::vector<unsigned int> &items) const
+{
+    if (nodes.empty())
+    {
+        return;
+    }
+
+    unsigned int stack[max_stack_size];
+    unsigned int stack_size = 0;
+    stack[stack_size++] = 0;
+    while (stack_size > 0)
+    {
+        const Node &node = nodes[stack[--stack_size]];
+        if (!frustum.intersects_box(node.min, node.max))
+        {
+            continue;
+        }
+        if (node.count > 0)
+        {
+            for (unsigned int k = node.first; k < node.first + node.count; k++)
+            {
+                if (node.count == 1 || frustum.intersects_box(boxes[order[k]].min, boxes[order[k]].max))
+                {
+                    items.push_back(order[k]);
+                }
+            }
+        }
+        else
+        {
+            stack[stack_size++] = node.first;
+            stack[stack_size++] = node.first + 1;
+        }
+    }
+}
+
+void Bvh::query_sphere(const glm::vec3 &center, float radius, std::vector<unsigned int> &items) const
+{
+    if (nodes.empty())
+    {
+        return;
+    }
+
+    auto overlaps = [&](const glm::vec3 &min, const glm::vec3 &max)
+    {
+        glm::vec3 offset = center - glm::clamp(center, min, max);
+        return glm::dot(offset, offset) <= radius * radius;
+    };
+
+    unsigned int stack[max_stack_size];
+    unsigned int stack_size = 0;
+    stack[stack_size++] = 0;
+    while (stack_size > 0)
+    {
+        const Node &node = nodes[stack[--stack_size]];
+        if (!overlaps(node.min, node.max))
+        {
+            continue;
+        }
+        if (node.count > 0)
+        {
+            for (unsigned int k = node.first; k < node.first + node.count; k++)
+            {
+                if (overlaps(boxes[order[k]].min, boxes[order[k]].max))
+                {
+                    items.push_back(order[k]);
+                }
+            }
+        }
+        else
+        {
+            stack[stack_size++] = node.first;
+            stack[stack_size++] = node.first + 1;
+        }
+    }
+}
+
+bool Bvh::raycast(const glm::vec3 &origin, const glm::vec3 &direction, float &distance, unsigned int &item,
+                  const std::function<bool(unsigned int item, float &distance)> &intersect) const
+{
+    if (nodes.empty())
+    {
+        return false;
+    }
+
+    const float infinity = std::numeric_limits<float>::infinity();
+    glm::vec3 inverse_direction = 1.0f / direction;
+    bool hit = false;
+
+    struct Entry
+    {
+        unsigned int node;
+        float enter;
+    };
+    Entry stack[max_stack_size];
+    unsigned int stack_size = 0;
+    float root_enter = ray_box(origin, inverse_direction, nodes[0].min, nodes[0].max, distance);
+    if (root_enter != infinity)
+    {
+        stack[stack_size++] = {0, root_enter};
+    }
+
+    while (stack_size > 0)
+    {
+        Entry entry = stack[--stack_size];
+        // a closer hit may have been found since this node was pushed
+        if (entry.enter > distance)
+        {
+            continue;
+        }
+
+        const Node &node = nodes[entry.node];
+        if (node.count > 0)
+        {
+            for (unsigned int k = node.first; k < node.first + node.count; k++)
+            {
+                unsigned int candidate = order[k];
+                const BoundingBox &box = boxes[candidate];
+                if (ray_box(origin, inverse_direction, box.min, box.max, distance) != infinity && intersect(candidate, distance))
+                {
+                    item = candidate;
+                    hit = true;
+                }
+            }
+            continue;
+        }
+
+        // push the farther child first so the nearer one is visited first
+        float left = ray_box(origin, inverse_direction, nodes[node.first].min, nodes[node.first].max, distance);
+        float right = ray_box(origin, inverse_direction, nodes[node.first + 1].min, nodes[node.first + 1].max, distance);
+        Entry near = {node.first, left};
+        Entry far = {node.first + 1, right};
+        if (right < left)
+        {
+            std::swap(near, far);
+        }
+        if (far.enter != infinity)
+        {
+            stack[stack_size++] = far;
+        }
+        if (near.enter != infinity)
+        {
+            stack[stack_size++] = near;
+        }
+    }
+    return hit;
+}
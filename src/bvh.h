@@ -0,0 +1,67 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <functional>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "frustum.h"
+
+struct BoundingBox
+{
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+// box around box transformed by matrix
+BoundingBox transform_box(const BoundingBox &box, const glm::mat4 &matrix);
+
+// Bounding volume hierarchy over a set of boxes, the items. Built top down with binned surface area heuristic splits,
+// large subtrees are built in parallel on the thread pool. When items move, update their boxes and refit() instead
+// of rebuilding, which keeps the tree valid at the cost of slowly degrading query performance.
+class Bvh
+{
+public:
+    // item i is boxes[i]
+    void build(std::vector<BoundingBox> boxes);
+    void clear();
+
+    size_t size() const { return boxes.size(); }
+    bool empty() const { return boxes.empty(); }
+    const BoundingBox &get_box(unsigned int item) const { return boxes[item]; }
+
+    // changes an item's box, the tree picks it up with the next refit()
+    void update(unsigned int item, const BoundingBox &box);
+    // recomputes the node boxes bottom up, does nothing if no item changed since the last refit
+    void refit();
+
+    // append every item whose box intersects the volume to items
+    void query_frustum(const Frustum &frustum, std::vector<unsigned int> &items) const;
+    void query_sphere(const glm::vec3 &center, float radius, std::vector<unsigned int> &items) const;
+
+    // walks the items whose boxes the ray hits front to back. intersect(item, distance) tests an item exactly and, on a hit,
+    // lowers distance and returns true. distance starts as the farthest distance of interest, in units of direction's length.
+    // Returns whether anything was hit, item receives the closest one.
+    bool raycast(const glm::vec3 &origin, const glm::vec3 &direction, float &distance, unsigned int &item,
+                 const std::function<bool(unsigned int item, float &distance)> &intersect) const;
+
+private:
+    // leaves have count > 0 and hold items order[first, first + count), inner nodes have their children at first and first + 1
+    struct Node
+    {
+        glm::vec3 min;
+        unsigned int first;
+        glm::vec3 max;
+        unsigned int count;
+    };
+
+    std::vector<BoundingBox> boxes;
+    std::vector<unsigned int> order;
+    std::vector<Node> nodes;
+    bool dirty = false;
+
+    struct Builder;
+};
+
+#endif
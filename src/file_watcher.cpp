@@ -0,0 +1,122 @@
+#include "file_watcher.h"
+
+#include <algorithm>
+#include <iostream>
+
+#ifdef __linux__
+#include <cerrno>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    std::filesystem::file_time_type modification_time(const std::string &path)
+    {
+        std::error_code error;
+        std::filesystem::file_time_type time = std::filesystem::last_write_time(path, error);
+        return error ? std::filesystem::file_time_type::min() : time;
+    }
+}
+
+FileWatcher::FileWatcher()
+{
+#ifdef __linux__
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0)
+    {
+        std::cout << "ERROR::FILE_WATCHER::INOTIFY_INIT_FAILED, falling back to polling" << std::endl;
+    }
+#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+#ifdef __linux__
+    if (inotify_fd >= 0)
+    {
+        close(inotify_fd);
+    }
+#endif
+}
+
+std::string FileWatcher::normalize(const std::string &path)
+{
+    return std::filesystem::path(path).lexically_normal().string();
+}
+
+void FileWatcher::add(const std::string &path)
+{
+    std::string file = normalize(path);
+    if (files.count(file))
+    {
+        return;
+    }
+    files[file] = modification_time(file);
+
+#ifdef __linux__
+    if (inotify_fd >= 0)
+    {
+        std::string directory = std::filesystem::path(file).parent_path().string();
+        if (directory.empty())
+        {
+            directory = ".";
+        }
+        // watching a directory twice returns the same descriptor
+        int watch = inotify_add_watch(inotify_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+        if (watch >= 0)
+        {
+            directories[watch] = directory;
+        }
+    }
+#endif
+}
+
+std::vector<std::string> FileWatcher::poll()
+{
+    std::vector<std::string> changed;
+
+#ifdef __linux__
+    if (inotify_fd >= 0)
+    {
+        alignas(inotify_event) char buffer[4096];
+        for (;;)
+        {
+            ssize_t length = read(inotify_fd, buffer, sizeof(buffer));
+            if (length <= 0)
+            {
+                // EAGAIN, nothing left to read
+                break;
+            }
+            for (char *position = buffer; position < buffer + length;)
+            {
+                const inotify_event *event = reinterpret_cast<const inotify_event *>(position);
+                position += sizeof(inotify_event) + event->len;
+
+                auto directory = directories.find(event->wd);
+                if (directory == directories.end() || event->len == 0)
+                {
+                    continue;
+                }
+                std::string file = normalize((std::filesystem::path(directory->second) / event->name).string());
+                if (files.count(file) && std::find(changed.begin(), changed.end(), file) == changed.end())
+                {
+                    changed.push_back(file);
+                }
+            }
+        }
+        return changed;
+    }
+#endif
+
+    for (auto &file : files)
+    {
+        std::filesystem::file_time_type time = modification_time(file.first);
+        if (time != file.second)
+        {
+            file.second = time;
+            changed.push_back(file.first);
+        }
+    }
+    return changed;
+}
@@ -0,0 +1,39 @@
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Reports files that changed on disk without blocking. On Linux this is inotify on the files' directories, which also
+// catches editors that save by writing a new file and renaming it over the old one. Elsewhere every poll compares
+// modification times.
+class FileWatcher
+{
+public:
+    FileWatcher();
+    ~FileWatcher();
+    FileWatcher(const FileWatcher &) = delete;
+    FileWatcher &operator=(const FileWatcher &) = delete;
+
+    // adding a file that is already watched does nothing
+    void add(const std::string &path);
+
+    // the watched files that changed since the last call, each reported once, in the normalized form of their path
+    std::vector<std::string> poll();
+
+    // the form paths are compared and reported in
+    static std::string normalize(const std::string &path);
+
+private:
+    // watched files and their modification time as of the last poll
+    std::unordered_map<std::string, std::filesystem::file_time_type> files;
+#ifdef __linux__
+    int inotify_fd = -1;
+    // watch descriptor of every watched directory
+    std::unordered_map<int, std::string> directories;
+#endif
+};
+
+#endif
@@ -0,0 +1,33 @@
+#include "frame_uniforms.h"
+
+#include "gl_state.h"
+#include "shader.h"
+
+static_assert(sizeof(FrameData) == 224, "FrameData must match the std140 layout of the Frame block");
+
+FrameUniforms::FrameUniforms()
+{
+    glGenBuffers(1, &UBO);
+    GLState::get().bind_buffer_base(GL_UNIFORM_BUFFER, FRAME_BLOCK_BINDING, UBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), nullptr, GL_DYNAMIC_DRAW);
+}
+
+FrameUniforms::~FrameUniforms()
+{
+    GLState::get().deleted_buffer(UBO);
+    glDeleteBuffers(1, &UBO);
+}
+
+void FrameUniforms::update(const glm::mat4 &view, const glm::mat4 &projection, const glm::vec3 &camera_position, float time)
+{
+    FrameData data;
+    data.view = view;
+    data.projection = projection;
+    data.view_projection = projection * view;
+    data.camera_position = glm::vec4(camera_position, 1.0f);
+    data.time = time;
+    data.padding[0] = data.padding[1] = data.padding[2] = 0.0f;
+
+    GLState::get().bind_buffer(GL_UNIFORM_BUFFER, UBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameData), &data);
+}
@@ -0,0 +1,35 @@
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// mirrors the std140 layout of the "Frame" uniform block, keep in sync with the shaders
+struct FrameData
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 view_projection;
+    glm::vec4 camera_position; // w is unused
+    float time;
+    float padding[3];
+};
+
+// Uniform buffer with the per frame camera state, bound to FRAME_BLOCK_BINDING once and shared by every program
+// that declares the Frame block, so switching programs doesn't mean uploading the matrices again.
+class FrameUniforms
+{
+public:
+    FrameUniforms();
+    ~FrameUniforms();
+    FrameUniforms(const FrameUniforms &) = delete;
+    FrameUniforms &operator=(const FrameUniforms &) = delete;
+
+    // uploads this frame's values, call once per frame before drawing
+    void update(const glm::mat4 &view, const glm::mat4 &projection, const glm::vec3 &camera_position, float time);
+
+private:
+    unsigned int UBO;
+};
+
+#endif
@@ -0,0 +1,73 @@
+#include "frustum.h"
+
+Frustum::Frustum()
+{
+    for (glm::vec4 &plane : planes)
+    {
+        plane = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    }
+}
+
+Frustum::Frustum(const glm::mat4 &matrix)
+{
+    // -w <= x, y, z <= w in clip space, each plane is the 4th row of the matrix plus or minus one of the others
+    glm::mat4 rows = glm::transpose(matrix);
+    planes[0] = rows[3] + rows[0]; // left
+    planes[1] = rows[3] - rows[0]; // right
+    planes[2] = rows[3] + rows[1]; // bottom
+    planes[3] = rows[3] - rows[1]; // top
+    planes[4] = rows[3] + rows[2]; // near
+    planes[5] = rows[3] - rows[2]; // far
+    normalize();
+}
+
+Frustum Frustum::transformed(const glm::mat4 &model) const
+{
+    // dot(plane, model * p) == dot(transpose(model) * plane, p)
+    Frustum frustum;
+    glm::mat4 transposed = glm::transpose(model);
+    for (int i = 0; i < 6; i++)
+    {
+        frustum.planes[i] = transposed * planes[i];
+    }
+    frustum.normalize();
+    return frustum;
+}
+
+bool Frustum::intersects_sphere(const glm::vec3 &center, float radius) const
+{
+    for (const glm::vec4 &plane : planes)
+    {
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Frustum::intersects_box(const glm::vec3 &min, const glm::vec3 &max) const
+{
+    for (const glm::vec4 &plane : planes)
+    {
+        // the corner furthest along the plane normal, if even that one is behind the plane the box is outside
+        glm::vec3 corner(plane.x >= 0.0f ? max.x : min.x, plane.y >= 0.0f ? max.y : min.y, plane.z >= 0.0f ? max.z : min.z);
+        if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Frustum::normalize()
+{
+    for (glm::vec4 &plane : planes)
+    {
+        float length = glm::length(glm::vec3(plane));
+        if (length > 0.0f)
+        {
+            plane /= length;
+        }
+    }
+}
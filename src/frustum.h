@@ -0,0 +1,28 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+// The six clip planes of a view volume, extracted from a combined projection matrix (Gribb and Hartmann).
+// Planes point inwards and are normalized, so dot(plane, vec4(p, 1)) is the signed distance of p to the plane.
+class Frustum
+{
+public:
+    glm::vec4 planes[6];
+
+    Frustum();
+    // planes in the space matrix transforms from, world space for projection * view
+    explicit Frustum(const glm::mat4 &matrix);
+
+    // the same frustum with its planes moved into the object space of model, which lets object space bounds be tested directly
+    Frustum transformed(const glm::mat4 &model) const;
+
+    // conservative tests, only false if the volume is entirely outside
+    bool intersects_sphere(const glm::vec3 &center, float radius) const;
+    bool intersects_box(const glm::vec3 &min, const glm::vec3 &max) const;
+
+private:
+    void normalize();
+};
+
+#endif
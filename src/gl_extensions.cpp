@@ -0,0 +1,62 @@
+#include "gl_extensions.h"
+
+#include <cstring>
+
+namespace
+{
+    GLExtensions extensions;
+
+    bool has_extension(const char *name)
+    {
+        int count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (int i = 0; i < count; i++)
+        {
+            const char *extension = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i));
+            if (extension && std::strcmp(extension, name) == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+const GLExtensions &GLExtensions::get()
+{
+    return extensions;
+}
+
+void GLExtensions::load(GLADloadproc load_function)
+{
+    extensions = GLExtensions();
+
+    if (has_extension("GL_ARB_get_program_binary"))
+    {
+        extensions.get_program_binary = (PFNGLGETPROGRAMBINARYPROC)load_function("glGetProgramBinary");
+        extensions.load_program_binary = (PFNGLPROGRAMBINARYPROC)load_function("glProgramBinary");
+        extensions.program_parameteri = (PFNGLPROGRAMPARAMETERIPROC)load_function("glProgramParameteri");
+        // some drivers expose the extension without supporting a single binary format
+        int format_count = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+        extensions.program_binary =
+            extensions.get_program_binary && extensions.load_program_binary && extensions.program_parameteri && format_count > 0;
+    }
+
+    if (has_extension("GL_KHR_parallel_shader_compile") || has_extension("GL_ARB_parallel_shader_compile"))
+    {
+        extensions.max_shader_compiler_threads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)load_function("glMaxShaderCompilerThreadsKHR");
+        if (!extensions.max_shader_compiler_threads)
+        {
+            extensions.max_shader_compiler_threads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)load_function("glMaxShaderCompilerThreadsARB");
+        }
+        extensions.parallel_shader_compile = extensions.max_shader_compiler_threads != nullptr;
+        if (extensions.parallel_shader_compile)
+        {
+            // let the driver pick how many threads it compiles on
+            extensions.max_shader_compiler_threads(0xFFFFFFFFu);
+        }
+    }
+
+    extensions.texture_compression_s3tc = has_extension("GL_EXT_texture_compression_s3tc");
+}
@@ -0,0 +1,48 @@
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+#include <glad/glad.h>
+
+// constants and entry points of optional extensions the GL 3.3 core loader doesn't cover
+
+// ARB_get_program_binary, core since 4.1
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+
+// KHR_parallel_shader_compile
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+// EXT_texture_compression_s3tc, BC1 and BC3. BC4 and BC5 are core as RGTC.
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#define GL_COMPRESSED_RGBA_S3TC_DXT3_EXT 0x83F2
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+
+// Which optional extensions the current context supports, filled in once by load() after glad is initialized.
+// Entry points are null when their extension is missing.
+struct GLExtensions
+{
+    bool program_binary = false;
+    PFNGLGETPROGRAMBINARYPROC get_program_binary = nullptr;
+    PFNGLPROGRAMBINARYPROC load_program_binary = nullptr;
+    PFNGLPROGRAMPARAMETERIPROC program_parameteri = nullptr;
+
+    // compile and link status can be polled with GL_COMPLETION_STATUS_KHR without waiting for the driver
+    bool parallel_shader_compile = false;
+    PFNGLMAXSHADERCOMPILERTHREADSKHRPROC max_shader_compiler_threads = nullptr;
+
+    // textures can be uploaded in the S3TC formats, practically every desktop driver has it
+    bool texture_compression_s3tc = false;
+
+    static const GLExtensions &get();
+    // must be called on the GL thread with the loader glad was initialized with
+    static void load(GLADloadproc load_function);
+};
+
+#endif
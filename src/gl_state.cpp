@@ -0,0 +1,268 @@
+#include "gl_state.h"
+
+namespace
+{
+    // index into the per target tables, -1 for targets that aren't tracked
+    int buffer_index(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_ARRAY_BUFFER:
+            return 0;
+        case GL_ELEMENT_ARRAY_BUFFER:
+            return 1;
+        case GL_UNIFORM_BUFFER:
+            return 2;
+        default:
+            return -1;
+        }
+    }
+
+    int texture_index(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_TEXTURE_2D:
+            return 0;
+        case GL_TEXTURE_2D_ARRAY:
+            return 1;
+        default:
+            return -1;
+        }
+    }
+
+    int capability_index(GLenum capability)
+    {
+        switch (capability)
+        {
+        case GL_DEPTH_TEST:
+            return 0;
+        case GL_BLEND:
+            return 1;
+        case GL_CULL_FACE:
+            return 2;
+        default:
+            return -1;
+        }
+    }
+}
+
+GLState &GLState::get()
+{
+    // intentionally never destroyed, GL objects released during static destruction still report to it
+    static GLState *state = new GLState();
+    return *state;
+}
+
+GLState::GLState()
+{
+    invalidate();
+}
+
+void GLState::invalidate()
+{
+    program = unknown;
+    vao = unknown;
+    for (unsigned int &buffer : buffers)
+    {
+        buffer = unknown;
+    }
+    active_unit = unknown;
+    for (unsigned int unit = 0; unit < texture_units; unit++)
+    {
+        for (unsigned int &texture : textures[unit])
+        {
+            texture = unknown;
+        }
+    }
+    for (unsigned int &enabled : capability_enabled)
+    {
+        enabled = unknown;
+    }
+    depth_mask = unknown;
+    depth_func = unknown;
+    blend_source = unknown;
+    blend_destination = unknown;
+}
+
+void GLState::reset_counters()
+{
+    calls_made = 0;
+    calls_elided = 0;
+}
+
+bool GLState::cached(unsigned int &value, unsigned int wanted)
+{
+    if (value == wanted)
+    {
+        calls_elided++;
+        return true;
+    }
+    value = wanted;
+    calls_made++;
+    return false;
+}
+
+void GLState::use_program(unsigned int program)
+{
+    if (!cached(this->program, program))
+    {
+        glUseProgram(program);
+    }
+}
+
+void GLState::bind_vertex_array(unsigned int vao)
+{
+    if (!cached(this->vao, vao))
+    {
+        glBindVertexArray(vao);
+        // the element buffer binding is part of the VAO
+        buffers[buffer_index(GL_ELEMENT_ARRAY_BUFFER)] = unknown;
+    }
+}
+
+void GLState::bind_buffer(GLenum target, unsigned int buffer)
+{
+    int index = buffer_index(target);
+    if (index < 0)
+    {
+        calls_made++;
+        glBindBuffer(target, buffer);
+    }
+    else if (!cached(buffers[index], buffer))
+    {
+        glBindBuffer(target, buffer);
+    }
+}
+
+void GLState::bind_buffer_base(GLenum target, unsigned int index, unsigned int buffer)
+{
+    calls_made++;
+    glBindBufferBase(target, index, buffer);
+    int target_index = buffer_index(target);
+    if (target_index >= 0)
+    {
+        buffers[target_index] = buffer;
+    }
+}
+
+void GLState::bind_texture(unsigned int unit, GLenum target, unsigned int texture)
+{
+    int index = texture_index(target);
+    if (index < 0 || unit >= texture_units)
+    {
+        if (!cached(active_unit, unit))
+        {
+            glActiveTexture(GL_TEXTURE0 + unit);
+        }
+        calls_made++;
+        glBindTexture(target, texture);
+        return;
+    }
+
+    if (textures[unit][index] == texture)
+    {
+        calls_elided++;
+        return;
+    }
+    if (!cached(active_unit, unit))
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+    textures[unit][index] = texture;
+    calls_made++;
+    glBindTexture(target, texture);
+}
+
+void GLState::set_capability(GLenum capability, bool enabled)
+{
+    int index = capability_index(capability);
+    if (index >= 0 && cached(capability_enabled[index], enabled ? 1 : 0))
+    {
+        return;
+    }
+    if (index < 0)
+    {
+        calls_made++;
+    }
+    if (enabled)
+    {
+        glEnable(capability);
+    }
+    else
+    {
+        glDisable(capability);
+    }
+}
+
+void GLState::set_depth_mask(bool enabled)
+{
+    if (!cached(depth_mask, enabled ? 1 : 0))
+    {
+        glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+    }
+}
+
+void GLState::set_depth_func(GLenum function)
+{
+    if (!cached(depth_func, function))
+    {
+        glDepthFunc(function);
+    }
+}
+
+void GLState::set_blend_func(GLenum source, GLenum destination)
+{
+    if (blend_source == source && blend_destination == destination)
+    {
+        calls_elided++;
+        return;
+    }
+    blend_source = source;
+    blend_destination = destination;
+    calls_made++;
+    glBlendFunc(source, destination);
+}
+
+void GLState::deleted_program(unsigned int program)
+{
+    // a deleted program in use stays in use until another one is, but its name may be handed out again
+    if (this->program == program)
+    {
+        this->program = unknown;
+    }
+}
+
+void GLState::deleted_vertex_array(unsigned int vao)
+{
+    if (this->vao == vao)
+    {
+        this->vao = 0;
+        buffers[buffer_index(GL_ELEMENT_ARRAY_BUFFER)] = unknown;
+    }
+}
+
+void GLState::deleted_buffer(unsigned int buffer)
+{
+    for (unsigned int &bound : buffers)
+    {
+        if (bound == buffer)
+        {
+            bound = 0;
+        }
+    }
+}
+
+void GLState::deleted_texture(unsigned int texture)
+{
+    for (unsigned int unit = 0; unit < texture_units; unit++)
+    {
+        for (unsigned int &bound : textures[unit])
+        {
+            if (bound == texture)
+            {
+                bound = 0;
+            }
+        }
+    }
+}
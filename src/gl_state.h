@@ -0,0 +1,68 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+// Shadow copy of the GL bindings and fixed function state the renderer changes: program, VAO, buffer bindings,
+// texture units and depth/blend state. Calls that would set what is already set are dropped and counted.
+// All such state has to be changed through here; code that changes it behind the cache's back calls invalidate().
+class GLState
+{
+public:
+    // the state of the context current on the calling thread, only use it on the GL thread
+    static GLState &get();
+
+    void use_program(unsigned int program);
+    void bind_vertex_array(unsigned int vao);
+    // GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER or GL_UNIFORM_BUFFER, other targets go straight to GL
+    void bind_buffer(GLenum target, unsigned int buffer);
+    // binds to an indexed binding point, which also sets the target's generic binding
+    void bind_buffer_base(GLenum target, unsigned int index, unsigned int buffer);
+    // GL_TEXTURE_2D or GL_TEXTURE_2D_ARRAY, switches the active unit only when needed
+    void bind_texture(unsigned int unit, GLenum target, unsigned int texture);
+
+    // GL_DEPTH_TEST, GL_BLEND or GL_CULL_FACE
+    void set_capability(GLenum capability, bool enabled);
+    void set_depth_mask(bool enabled);
+    void set_depth_func(GLenum function);
+    void set_blend_func(GLenum source, GLenum destination);
+
+    // deleting a bound object resets the binding to 0 in GL, and the name may come back for a new object
+    void deleted_program(unsigned int program);
+    void deleted_vertex_array(unsigned int vao);
+    void deleted_buffer(unsigned int buffer);
+    void deleted_texture(unsigned int texture);
+
+    // forgets everything, the next call of every kind goes to GL
+    void invalidate();
+
+    // GL calls made and dropped as redundant since the last reset_counters()
+    unsigned int calls_made = 0;
+    unsigned int calls_elided = 0;
+    void reset_counters();
+
+private:
+    static const unsigned int unknown = ~0u;
+    static const unsigned int texture_units = 32;
+    static const unsigned int buffer_targets = 3;
+    static const unsigned int texture_targets = 2;
+    static const unsigned int capabilities = 3;
+
+    unsigned int program;
+    unsigned int vao;
+    unsigned int buffers[buffer_targets];
+    unsigned int active_unit;
+    unsigned int textures[texture_units][texture_targets];
+    // 0 or 1, unknown until first set
+    unsigned int capability_enabled[capabilities];
+    unsigned int depth_mask;
+    unsigned int depth_func;
+    unsigned int blend_source;
+    unsigned int blend_destination;
+
+    GLState();
+    // true if value already holds wanted, otherwise stores it and returns false
+    bool cached(unsigned int &value, unsigned int wanted);
+};
+
+#endif
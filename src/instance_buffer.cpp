@@ -0,0 +1,49 @@
+#include "instance_buffer.h"
+
+#include "gl_state.h"
+
+InstanceBuffer::InstanceBuffer()
+{
+    glGenBuffers(1, &VBO);
+}
+
+InstanceBuffer::~InstanceBuffer()
+{
+    GLState::get().deleted_buffer(VBO);
+    glDeleteBuffers(1, &VBO);
+}
+
+void InstanceBuffer::set(const std::vector<glm::mat4> &transforms)
+{
+    count = transforms.size();
+    GLState::get().bind_buffer(GL_ARRAY_BUFFER, VBO);
+    if (count > capacity)
+    {
+        capacity = count;
+    }
+    glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+    if (count > 0)
+    {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(glm::mat4), transforms.data());
+    }
+}
+
+void InstanceBuffer::bind_attributes() const
+{
+    GLState::get().bind_buffer(GL_ARRAY_BUFFER, VBO);
+    for (unsigned int column = 0; column < 4; column++)
+    {
+        unsigned int location = INSTANCE_ATTRIBUTE_LOCATION + column;
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void *)(column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(location, 1);
+    }
+}
+
+void InstanceBuffer::unbind_attributes()
+{
+    for (unsigned int column = 0; column < 4; column++)
+    {
+        glDisableVertexAttribArray(INSTANCE_ATTRIBUTE_LOCATION + column);
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef INSTANCE_BUFFER_H
+#define INSTANCE_BUFFER_H
+
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// first of the four attribute locations the per instance model matrix takes up, one per column
+const unsigned int INSTANCE_ATTRIBUTE_LOCATION = 3;
+
+// Per instance model matrices for instanced draws, see Model::draw_instanced. The matrices are fed to main.vert
+// as a mat4 attribute that advances once per instance.
+class InstanceBuffer
+{
+public:
+    InstanceBuffer();
+    ~InstanceBuffer();
+    InstanceBuffer(const InstanceBuffer &) = delete;
+    InstanceBuffer &operator=(const InstanceBuffer &) = delete;
+
+    // replaces the contents, the storage is orphaned so draws still reading the previous transforms don't stall
+    void set(const std::vector<glm::mat4> &transforms);
+    size_t size() const { return count; }
+
+    // points the instance attributes of the bound VAO at this buffer and enables them
+    void bind_attributes() const;
+    // disables them again, so non-instanced draws of the same VAO don't read from the buffer
+    static void unbind_attributes();
+
+private:
+    unsigned int VBO;
+    size_t count = 0;
+    size_t capacity = 0;
+};
+
+#endif
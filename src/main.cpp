@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 
@@ -8,8 +9,14 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include "camera.h"
+#include "frame_uniforms.h"
+#include "gl_extensions.h"
+#include "gl_state.h"
 #include "model.h"
+#include "scene.h"
 #include "shader.h"
+#include "shader_library.h"
+#include "shader_reloader.h"
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 void mouse_callback(GLFWwindow *window, double x_pos, double y_pos);
@@ -20,6 +27,7 @@ void process_input(GLFWwindow *window);
 const unsigned int WINDOW_WIDTH = 1600;
 const unsigned int WINDOW_HEIGHT = 1200;
 const unsigned int N_POINT_LIGHTS = 4;
+const double MODEL_UPLOAD_BUDGET_MS = 2.0; // time per frame spent uploading a model that is still loading
 
 // camera
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
@@ -27,6 +35,10 @@ float last_x = WINDOW_WIDTH / 2.0f;
 float last_y = WINDOW_HEIGHT / 2.0f;
 bool first_call = true;
 
+// framebuffer size in pixels, which differs from the window size on high dpi displays and changes on resize
+int framebuffer_width = WINDOW_WIDTH;
+int framebuffer_height = WINDOW_HEIGHT;
+
 // timing
 float delta_time = 0.0f; // Time between current frame and last frame
 float last_frame = 0.0f; // Time of last frame
@@ -69,6 +81,7 @@ int main()
     }
     glfwMakeContextCurrent(window);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwGetFramebufferSize(window, &framebuffer_width, &framebuffer_height);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
 
@@ -82,18 +95,46 @@ int main()
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    GLExtensions::load((GLADloadproc)glfwGetProcAddress);
 
     // configure global opengl state
     // -----------------------------
-    glEnable(GL_DEPTH_TEST);
+    GLState::get().set_capability(GL_DEPTH_TEST, true);
 
     // build and compile our shader program
     // ------------------------------------
-    Shader main_shader = Shader(vertex_shader_path, fragment_shader_path);
-    Shader light_shader = Shader(light_vertex_shader_path, light_fragment_shader_path);
-
-    // load model
-    Model obj_model(model_path);
+    // all programs are submitted up front and finish in the background while the model loads
+    // the model's materials are packed into texture arrays, so the main program is the variant sampling those
+    ShaderLibrary shader_library;
+    Shader &main_shader = shader_library.get(vertex_shader_path, fragment_shader_path, {"TEXTURE_ARRAYS"});
+    Shader light_shader = Shader(light_vertex_shader_path, light_fragment_shader_path, true);
+    ShaderBatch shaders;
+    shaders.add(main_shader);
+    shaders.add(light_shader);
+
+    // edits to the shader files show up without a restart
+    ShaderReloader shader_reloader;
+    shader_reloader.watch(shader_library);
+    shader_reloader.watch(main_shader);
+    shader_reloader.watch(light_shader);
+
+    // camera matrices shared by all programs through one uniform buffer
+    FrameUniforms frame_uniforms;
+
+    // load model in the background, its meshes show up as they finish uploading into one shared buffer
+    // and materials that differ only in their textures are drawn together through texture arrays
+    ModelOptions model_options;
+    model_options.shared_buffers = true;
+    model_options.texture_arrays = true;
+    model_options.compress_textures = true;
+    Model obj_model(model_path, true, model_options);
+
+    // everything drawn through the scene is culled against its bounding volume hierarchy
+    glm::mat4 model = glm::mat4(1.0f);
+    model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f)); // translate it down so it's at the center of the scene
+    model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));     // it's a bit too big for our scene, so scale it down
+    Scene scene;
+    scene.add(obj_model, model);
 
     // render loop
     // -----------
@@ -104,29 +145,38 @@ int main()
         delta_time = current_frame - last_frame;
         last_frame = current_frame;
 
+        // GL calls made and elided are counted per frame
+        GLState::get().reset_counters();
+
         // input
         // -----
         process_input(window);
 
+        // streaming
+        // ---------
+        obj_model.update(MODEL_UPLOAD_BUDGET_MS);
+        scene.update();
+        shader_reloader.update();
+
         // render
         // ------
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        main_shader.use();
-
         // view/projection transformations
-        glm::mat4 projection = glm::perspective(glm::radians(camera.zoom), (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT, 0.1f, 100.0f);
+        // a minimized window has a zero sized framebuffer
+        int viewport_height = std::max(framebuffer_height, 1);
+        float aspect = (float)framebuffer_width / (float)viewport_height;
+        glm::mat4 projection = glm::perspective(glm::radians(camera.zoom), aspect, 0.1f, 100.0f);
         glm::mat4 view = camera.get_view_matrix();
-        main_shader.set_mat4("projection", projection);
-        main_shader.set_mat4("view", view);
+        frame_uniforms.update(view, projection, camera.position, current_frame);
 
-        // render the loaded model
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f)); // translate it down so it's at the center of the scene
-        model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));     // it's a bit too big for our scene, so scale it down
-        main_shader.set_mat4("model", model);
-        obj_model.draw(main_shader);
+        // render the loaded model once its program is built
+        if (shaders.is_ready())
+        {
+            main_shader.use();
+            scene.draw(main_shader, camera, projection, view, static_cast<float>(viewport_height));
+        }
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
@@ -183,6 +233,8 @@ void framebuffer_size_callback(GLFWwindow *window, int width, int height)
     // make sure the viewport matches the new window dimensions; note that width and
     // height will be significantly larger than specified on retina displays.
     glViewport(0, 0, width, height);
+    framebuffer_width = width;
+    framebuffer_height = height;
 }
 
 void mouse_callback(GLFWwindow *window, double x_pos_in, double y_pos_in)
@@ -0,0 +1,86 @@
+#include "mapped_file.h"
+
+#include <fstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::string &path)
+{
+    close();
+
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void *address = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping stays valid after the descriptor is closed
+    ::close(fd);
+    if (address == MAP_FAILED)
+    {
+        return false;
+    }
+
+    bytes = static_cast<const unsigned char *>(address);
+    length = static_cast<size_t>(info.st_size);
+    mapped = true;
+    return true;
+#else
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+    {
+        return false;
+    }
+
+    std::streamsize file_size = file.tellg();
+    if (file_size <= 0)
+    {
+        return false;
+    }
+
+    buffer.resize(static_cast<size_t>(file_size));
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char *>(buffer.data()), file_size))
+    {
+        buffer.clear();
+        return false;
+    }
+
+    bytes = buffer.data();
+    length = buffer.size();
+    return true;
+#endif
+}
+
+void MappedFile::close()
+{
+#ifndef _WIN32
+    if (mapped)
+    {
+        munmap(const_cast<unsigned char *>(bytes), length);
+    }
+#endif
+    buffer.clear();
+    bytes = nullptr;
+    length = 0;
+    mapped = false;
+}
@@ -1,40 +1,191 @@
 #include "mesh.h"
 
-Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures) : vertices(vertices), indices(indices), textures(textures)
+#include <algorithm>
+#include <cmath>
+
+#include <glm/gtc/packing.hpp>
+
+#include "gl_state.h"
+
+namespace
 {
+    const UniformId POSITION_OFFSET = uniform_id("position_offset");
+    const UniformId POSITION_SCALE = uniform_id("position_scale");
+    const UniformId OCTAHEDRAL_NORMALS = uniform_id("octahedral_normals");
+}
+
+MeshBounds compute_bounds(const std::vector<Vertex> &vertices)
+{
+    MeshBounds bounds;
+    bounds.radius = 0.0f;
+    if (vertices.empty())
+    {
+        return bounds;
+    }
+
+    bounds.min = bounds.max = vertices[0].position;
+    for (const Vertex &vertex : vertices)
+    {
+        bounds.min = glm::min(bounds.min, vertex.position);
+        bounds.max = glm::max(bounds.max, vertex.position);
+    }
+    bounds.center = (bounds.min + bounds.max) * 0.5f;
+
+    // tighter than half the box diagonal unless the vertices actually reach into the corners
+    float radius_squared = 0.0f;
+    for (const Vertex &vertex : vertices)
+    {
+        glm::vec3 offset = vertex.position - bounds.center;
+        radius_squared = std::max(radius_squared, glm::dot(offset, offset));
+    }
+    bounds.radius = std::sqrt(radius_squared);
+    return bounds;
+}
+
+Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures, std::vector<MeshLod> lods,
+           const MeshBounds &bounds, Vertex_Format format)
+    : vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures)), lods(std::move(lods)), bounds(bounds),
+      format(format)
+{
+    if (this->lods.empty())
+    {
+        this->lods.push_back({0, static_cast<unsigned int>(this->indices.size()), 0.0f});
+    }
+    if (this->bounds.radius < 0.0f)
+    {
+        this->bounds = compute_bounds(this->vertices);
+    }
+
+    setup_texture_uniforms();
     setup_mesh();
 }
 
-void Mesh::draw(Shader &shader)
+Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures, std::vector<MeshLod> lods,
+           const MeshBounds &bounds, const MeshBufferRange &range)
+    : vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures)), lods(std::move(lods)), bounds(bounds),
+      VAO(range.VAO), index_type(range.index_type), first_index(range.first_index), base_vertex(range.base_vertex), format(range.format),
+      position_offset(range.position_offset), position_scale(range.position_scale)
 {
-    unsigned int diffuse_n = 1;
-    unsigned int specular_n = 1;
+    if (this->lods.empty())
+    {
+        this->lods.push_back({0, static_cast<unsigned int>(this->indices.size()), 0.0f});
+    }
+    if (this->bounds.radius < 0.0f)
+    {
+        this->bounds = compute_bounds(this->vertices);
+    }
+
+    setup_texture_uniforms();
+}
+
+bool Mesh::is_visible(const RenderView &view) const
+{
+    // the sphere rejects most meshes with a handful of dot products, the box is tighter for long thin ones
+    return view.object_frustum.intersects_sphere(bounds.center, bounds.radius) && view.object_frustum.intersects_box(bounds.min, bounds.max);
+}
+
+unsigned int Mesh::select_lod(const RenderView &view) const
+{
+    // distance to the closest point of the bounding sphere, in world units
+    glm::vec3 center = glm::vec3(view.model * glm::vec4(bounds.center, 1.0f));
+    float scale = view.model_scale();
+    float distance = std::max(glm::length(center - view.camera_position) - bounds.radius * scale, 1e-4f);
+
+    // errors grow with every level, so walk down from the coarsest one
+    for (unsigned int lod = static_cast<unsigned int>(lods.size()) - 1; lod > 0; lod--)
+    {
+        float pixels = lods[lod].error * scale * view.projection_scale / distance;
+        if (pixels <= view.lod_threshold)
+        {
+            return lod;
+        }
+    }
+    return 0;
+}
+
+void Mesh::draw(Shader &shader, unsigned int lod)
+{
+    bind_textures(shader);
+    set_vertex_uniforms(shader);
 
+    // draw mesh
+    GLsizei count;
+    void *offset;
+    GLint vertex_offset;
+    get_draw_arguments(lod, count, offset, vertex_offset);
+    GLState::get().bind_vertex_array(VAO);
+    glDrawElementsBaseVertex(GL_TRIANGLES, count, index_type, offset, vertex_offset);
+}
+
+void Mesh::draw_instanced(Shader &shader, const InstanceBuffer &instances, unsigned int lod)
+{
+    bind_textures(shader);
+    set_vertex_uniforms(shader);
+
+    GLsizei count;
+    void *offset;
+    GLint vertex_offset;
+    get_draw_arguments(lod, count, offset, vertex_offset);
+    GLState::get().bind_vertex_array(VAO);
+    instances.bind_attributes();
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, count, index_type, offset, static_cast<GLsizei>(instances.size()), vertex_offset);
+    InstanceBuffer::unbind_attributes();
+}
+
+void Mesh::bind_textures(Shader &shader) const
+{
+    GLState &state = GLState::get();
     for (int i = 0; i < textures.size(); i++)
     {
-        glActiveTexture(GL_TEXTURE0 + i);
+        shader.set_int(texture_uniforms[i], i);
+        state.bind_texture(i, textures[i].handle->target, textures[i].handle->id);
+    }
+}
+
+void Mesh::set_vertex_uniforms(Shader &shader) const
+{
+    // vertex dequantization, identity for float vertices
+    shader.set_vec3(POSITION_OFFSET, position_offset);
+    shader.set_vec3(POSITION_SCALE, position_scale);
+    shader.set_bool(OCTAHEDRAL_NORMALS, format == COMPACT_VERTICES);
+    // current attribute value, only read while the VAO has no per vertex layers enabled
+    glVertexAttrib1f(TEXTURE_LAYER_ATTRIBUTE_LOCATION, static_cast<float>(texture_layer));
+}
+
+void Mesh::get_draw_arguments(unsigned int lod, GLsizei &count, void *&offset, GLint &vertex_offset) const
+{
+    const MeshLod &level = lods[std::min<size_t>(lod, lods.size() - 1)];
+    size_t index_size = index_type == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+    count = static_cast<GLsizei>(level.index_count);
+    offset = (void *)((first_index + level.first_index) * index_size);
+    vertex_offset = base_vertex;
+}
+
+void Mesh::setup_texture_uniforms()
+{
+    unsigned int diffuse_n = 1;
+    unsigned int specular_n = 1;
+    unsigned int normal_n = 1;
 
+    texture_uniforms.clear();
+    for (const Texture &texture : textures)
+    {
         std::string number;
-        std::string name = textures[i].type;
-        if (name == "texture_diffuse")
+        if (texture.type == "texture_diffuse")
         {
             number = std::to_string(diffuse_n++);
         }
-        else if (name == "texture_specular")
+        else if (texture.type == "texture_specular")
         {
             number = std::to_string(specular_n++);
         }
-
-        shader.set_int(("material." + name + number).c_str(), i);
-        glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        else if (texture.type == "texture_normal")
+        {
+            number = std::to_string(normal_n++);
+        }
+        std::string array = texture.handle->target == GL_TEXTURE_2D_ARRAY ? "_array" : "";
+        texture_uniforms.push_back(uniform_id(("material." + texture.type + array + number).c_str()));
     }
-
-    glActiveTexture(GL_TEXTURE0);
-
-    // draw mesh
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
 }
 
 void Mesh::setup_mesh()
@@ -43,23 +194,102 @@ void Mesh::setup_mesh()
     glGenBuffers(1, &VBO);
     glGenBuffers(1, &EBO);
 
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    GLState &state = GLState::get();
+    state.bind_vertex_array(VAO);
+    state.bind_buffer(GL_ARRAY_BUFFER, VBO);
+
+    if (format == COMPACT_VERTICES)
+    {
+        quantization_range(bounds.min, bounds.max, position_offset, position_scale);
+        std::vector<PackedVertex> packed = pack_vertices(vertices, position_offset, position_scale);
+        glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(PackedVertex), packed.data(), GL_STATIC_DRAW);
+    }
+    else
+    {
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+    }
+
+    state.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    if (vertices.size() <= 65536)
+    {
+        // halves index memory and fetch bandwidth for the common case of small meshes
+        std::vector<unsigned short> short_indices(indices.begin(), indices.end());
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, short_indices.size() * sizeof(unsigned short), short_indices.data(), GL_STATIC_DRAW);
+        index_type = GL_UNSIGNED_SHORT;
+    }
+    else
+    {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        index_type = GL_UNSIGNED_INT;
+    }
+
+    setup_vertex_attributes(format);
+}
+
+void quantization_range(const glm::vec3 &min, const glm::vec3 &max, glm::vec3 &offset, glm::vec3 &scale)
+{
+    // positions are stored relative to the bounding box so the full 16 bit range covers it
+    offset = (min + max) * 0.5f;
+    scale = glm::max((max - min) * 0.5f, glm::vec3(1e-6f));
+}
+
+std::vector<PackedVertex> pack_vertices(const std::vector<Vertex> &vertices, const glm::vec3 &position_offset, const glm::vec3 &position_scale)
+{
+    std::vector<PackedVertex> packed(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        const Vertex &vertex = vertices[i];
+        PackedVertex &out = packed[i];
 
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+        glm::vec3 position = glm::clamp((vertex.position - position_offset) / position_scale, -1.0f, 1.0f);
+        out.position[0] = static_cast<short>(std::round(position.x * 32767.0f));
+        out.position[1] = static_cast<short>(std::round(position.y * 32767.0f));
+        out.position[2] = static_cast<short>(std::round(position.z * 32767.0f));
+        out.position[3] = 0;
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        // octahedral encoding: project onto the octahedron, then fold the lower half over the upper one
+        glm::vec3 normal = vertex.normal;
+        float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+        glm::vec2 encoded = length > 0.0f ? glm::vec2(normal.x, normal.y) / length : glm::vec2(0.0f);
+        if (normal.z < 0.0f)
+        {
+            glm::vec2 folded = 1.0f - glm::abs(glm::vec2(encoded.y, encoded.x));
+            encoded.x = encoded.x >= 0.0f ? folded.x : -folded.x;
+            encoded.y = encoded.y >= 0.0f ? folded.y : -folded.y;
+        }
+        out.normal[0] = static_cast<short>(std::round(glm::clamp(encoded.x, -1.0f, 1.0f) * 32767.0f));
+        out.normal[1] = static_cast<short>(std::round(glm::clamp(encoded.y, -1.0f, 1.0f) * 32767.0f));
 
-    // vertex positions
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)0);
-    // vertex normals
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, normal));
-    // vertex texture coords
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, texture_coords));
+        out.texture_coords[0] = glm::packHalf1x16(vertex.texture_coords.x);
+        out.texture_coords[1] = glm::packHalf1x16(vertex.texture_coords.y);
+    }
+    return packed;
+}
 
-    glBindVertexArray(0);
+void setup_vertex_attributes(Vertex_Format format)
+{
+    if (format == COMPACT_VERTICES)
+    {
+        // vertex positions
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void *)offsetof(PackedVertex, position));
+        // vertex normals
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void *)offsetof(PackedVertex, normal));
+        // vertex texture coords
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void *)offsetof(PackedVertex, texture_coords));
+    }
+    else
+    {
+        // vertex positions
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)0);
+        // vertex normals
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, normal));
+        // vertex texture coords
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, texture_coords));
+    }
 }
@@ -6,7 +6,10 @@
 
 #include <glm/glm.hpp>
 
+#include "instance_buffer.h"
+#include "render_view.h"
 #include "shader.h"
+#include "texture_registry.h"
 
 struct Vertex
 {
@@ -15,9 +18,71 @@ struct Vertex
     glm::vec2 texture_coords;
 };
 
+// layer of the material's texture arrays, a per vertex attribute in shared buffers and a constant attribute otherwise
+const unsigned int TEXTURE_LAYER_ATTRIBUTE_LOCATION = 7;
+
+// GPU vertex layouts a mesh can be uploaded with
+enum Vertex_Format
+{
+    // Vertex as is, 32 bytes
+    FLOAT_VERTICES,
+    // PackedVertex, 16 bytes: positions quantized to the mesh bounds, octahedral normals and half float texture coordinates
+    COMPACT_VERTICES
+};
+
+// compact GPU layout, dequantized by main.vert
+struct PackedVertex
+{
+    short position[4]; // snorm16 relative to the mesh bounds, w is padding
+    short normal[2];   // snorm16 octahedral encoding
+    unsigned short texture_coords[2]; // half floats
+};
+
+// a level of detail, a range of the mesh's index buffer. All levels share the vertex buffer.
+struct MeshLod
+{
+    unsigned int first_index;
+    unsigned int index_count;
+    // largest deviation from the full detail surface, in object space units
+    float error;
+};
+
+// object space bounds of a mesh's vertices
+struct MeshBounds
+{
+    glm::vec3 min = glm::vec3(0.0f);
+    glm::vec3 max = glm::vec3(0.0f);
+    glm::vec3 center = glm::vec3(0.0f);
+    // negative while the bounds haven't been computed
+    float radius = -1.0f;
+};
+
+// box around the vertices and the smallest sphere around them that is centered on the box
+MeshBounds compute_bounds(const std::vector<Vertex> &vertices);
+
+// quantization a COMPACT_VERTICES buffer uses for positions between min and max: offset + scale * snorm16
+void quantization_range(const glm::vec3 &min, const glm::vec3 &max, glm::vec3 &offset, glm::vec3 &scale);
+std::vector<PackedVertex> pack_vertices(const std::vector<Vertex> &vertices, const glm::vec3 &offset, const glm::vec3 &scale);
+
+// points the vertex attributes of the bound VAO at the bound vertex buffer, laid out in format
+void setup_vertex_attributes(Vertex_Format format);
+
+// where a mesh lives inside buffers shared with other meshes, see MeshBuffer
+struct MeshBufferRange
+{
+    unsigned int VAO;
+    GLenum index_type;
+    // offset of the mesh's indices in the element buffer, in indices, and of its vertices in the vertex buffer
+    unsigned int first_index;
+    int base_vertex;
+    Vertex_Format format;
+    glm::vec3 position_offset;
+    glm::vec3 position_scale;
+};
+
 struct Texture
 {
-    unsigned int id;
+    TextureHandle handle;
     std::string type;
     std::string path;
 };
@@ -28,16 +93,63 @@ public:
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
     std::vector<Texture> textures;
+    // index ranges of the levels of detail, finest first
+    std::vector<MeshLod> lods;
+    MeshBounds bounds;
+    // identifies the mesh's textures across all models, meshes with the same id can be drawn without rebinding them
+    unsigned int material_id = 0;
+    // layer of the mesh's textures when they are texture arrays, see texture_array.h
+    unsigned int texture_layer = 0;
+
+    // the arrays are moved into the mesh, pass them with std::move to avoid copying the vertex data.
+    // Without lods the whole index array is the only level, bounds are computed from the vertices if not given.
+    Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures,
+         std::vector<MeshLod> lods = std::vector<MeshLod>(), const MeshBounds &bounds = MeshBounds(), Vertex_Format format = FLOAT_VERTICES);
+    // a mesh whose data was already uploaded into a shared buffer, creates no GL objects of its own
+    Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures, std::vector<MeshLod> lods,
+         const MeshBounds &bounds, const MeshBufferRange &range);
+    void draw(Shader &shader, unsigned int lod = 0);
+    // draws a level once per transform in instances, the shader has to be told to use them (see Model::draw_instanced)
+    void draw_instanced(Shader &shader, const InstanceBuffer &instances, unsigned int lod = 0);
 
-    Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures);
-    void draw(Shader &shader);
+    // the parts of draw(), for batching meshes that share textures and buffers
+    void bind_textures(Shader &shader) const;
+    void set_vertex_uniforms(Shader &shader) const;
+    // glDrawElementsBaseVertex arguments of a level
+    void get_draw_arguments(unsigned int lod, GLsizei &count, void *&offset, GLint &base_vertex) const;
+
+    unsigned int get_vao() const { return VAO; }
+    GLenum get_index_type() const { return index_type; }
+
+    // false if the mesh's bounds are entirely outside view.object_frustum
+    bool is_visible(const RenderView &view) const;
+
+    // coarsest level whose error projects to at most view.lod_threshold pixels on screen
+    unsigned int select_lod(const RenderView &view) const;
 
 private:
     unsigned int VAO;
-    unsigned int VBO;
-    unsigned int EBO;
+    // 0 for meshes in a shared buffer
+    unsigned int VBO = 0;
+    unsigned int EBO = 0;
+
+    // GL_UNSIGNED_SHORT for meshes whose vertices can all be addressed with 16 bits, GL_UNSIGNED_INT otherwise
+    GLenum index_type = GL_UNSIGNED_INT;
+    // where the mesh starts in its buffers, 0 for its own ones
+    unsigned int first_index = 0;
+    int base_vertex = 0;
+
+    // layout of the vertex buffer, compact meshes store positions as offset + scale * quantized value
+    Vertex_Format format;
+    glm::vec3 position_offset = glm::vec3(0.0f);
+    glm::vec3 position_scale = glm::vec3(1.0f);
+
+    // "material.<type><n>" sampler uniform of every texture, "material.<type>_array<n>" for texture arrays,
+    // hashed once here instead of built on every draw
+    std::vector<UniformId> texture_uniforms;
 
     void setup_mesh();
+    void setup_texture_uniforms();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,109 @@
+#include "mesh_buffer.h"
+
+#include <iostream>
+
+#include "gl_state.h"
+
+MeshBuffer::MeshBuffer(size_t vertex_count, size_t index_count, size_t max_mesh_vertices, const glm::vec3 &min, const glm::vec3 &max,
+                       Vertex_Format format, bool texture_layers)
+    : index_type(max_mesh_vertices <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT), format(format), vertex_capacity(vertex_count),
+      index_capacity(index_count)
+{
+    if (format == COMPACT_VERTICES)
+    {
+        // one quantization for all meshes, they are drawn together with the same uniforms
+        quantization_range(min, max, position_offset, position_scale);
+    }
+    size_t vertex_size = format == COMPACT_VERTICES ? sizeof(PackedVertex) : sizeof(Vertex);
+    size_t index_size = index_type == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+
+    GLState &state = GLState::get();
+    state.bind_vertex_array(VAO);
+    state.bind_buffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertex_capacity * vertex_size, nullptr, GL_STATIC_DRAW);
+    state.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_capacity * index_size, nullptr, GL_STATIC_DRAW);
+    setup_vertex_attributes(format);
+
+    if (texture_layers)
+    {
+        glGenBuffers(1, &layer_VBO);
+        state.bind_buffer(GL_ARRAY_BUFFER, layer_VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertex_capacity * sizeof(unsigned short), nullptr, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(TEXTURE_LAYER_ATTRIBUTE_LOCATION);
+        glVertexAttribPointer(TEXTURE_LAYER_ATTRIBUTE_LOCATION, 1, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(unsigned short), (void *)0);
+    }
+}
+
+MeshBuffer::~MeshBuffer()
+{
+    GLState &state = GLState::get();
+    state.deleted_vertex_array(VAO);
+    state.deleted_buffer(VBO);
+    state.deleted_buffer(EBO);
+    state.deleted_buffer(layer_VBO);
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    glDeleteBuffers(1, &layer_VBO);
+}
+
+MeshBufferRange MeshBuffer::append(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices, unsigned int texture_layer)
+{
+    MeshBufferRange range;
+    range.VAO = VAO;
+    range.index_type = index_type;
+    range.first_index = static_cast<unsigned int>(index_count);
+    range.base_vertex = static_cast<int>(vertex_count);
+    range.format = format;
+    range.position_offset = position_offset;
+    range.position_scale = position_scale;
+
+    if (vertex_count + vertices.size() > vertex_capacity || index_count + indices.size() > index_capacity)
+    {
+        std::cout << "ERROR::MESH_BUFFER::OUT_OF_SPACE" << std::endl;
+        range.first_index = 0;
+        range.base_vertex = 0;
+        return range;
+    }
+
+    GLState &state = GLState::get();
+    state.bind_buffer(GL_ARRAY_BUFFER, VBO);
+    if (format == COMPACT_VERTICES)
+    {
+        std::vector<PackedVertex> packed = pack_vertices(vertices, position_offset, position_scale);
+        glBufferSubData(GL_ARRAY_BUFFER, vertex_count * sizeof(PackedVertex), packed.size() * sizeof(PackedVertex), packed.data());
+    }
+    else
+    {
+        glBufferSubData(GL_ARRAY_BUFFER, vertex_count * sizeof(Vertex), vertices.size() * sizeof(Vertex), vertices.data());
+    }
+    if (layer_VBO != 0)
+    {
+        std::vector<unsigned short> layers(vertices.size(), static_cast<unsigned short>(texture_layer));
+        state.bind_buffer(GL_ARRAY_BUFFER, layer_VBO);
+        glBufferSubData(GL_ARRAY_BUFFER, vertex_count * sizeof(unsigned short), layers.size() * sizeof(unsigned short), layers.data());
+    }
+
+    // indices stay relative to the mesh, the draws add base_vertex. The element buffer binding is VAO state,
+    // so go through the VAO instead of binding the buffer on its own.
+    state.bind_vertex_array(VAO);
+    if (index_type == GL_UNSIGNED_SHORT)
+    {
+        std::vector<unsigned short> short_indices(indices.begin(), indices.end());
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, index_count * sizeof(unsigned short), short_indices.size() * sizeof(unsigned short),
+                        short_indices.data());
+    }
+    else
+    {
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, index_count * sizeof(unsigned int), indices.size() * sizeof(unsigned int), indices.data());
+    }
+
+    vertex_count += vertices.size();
+    index_count += indices.size();
+    return range;
+}
@@ -0,0 +1,50 @@
+#ifndef MESH_BUFFER_H
+#define MESH_BUFFER_H
+
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "mesh.h"
+
+// One vertex buffer, one element buffer and one VAO for all meshes of a model. Meshes sharing it can be drawn
+// with one glMultiDrawElementsBaseVertex per material instead of a VAO bind and draw call per mesh. The buffers
+// are allocated up front for the whole model and meshes are appended as they get uploaded.
+class MeshBuffer
+{
+public:
+    // indices are 16 bit if no mesh has more than 65536 vertices, compact vertices are quantized to min and max.
+    // With texture_layers, every vertex also gets the texture array layer of its mesh so meshes with different
+    // layers can share a draw call.
+    MeshBuffer(size_t vertex_count, size_t index_count, size_t max_mesh_vertices, const glm::vec3 &min, const glm::vec3 &max, Vertex_Format format,
+               bool texture_layers = false);
+    ~MeshBuffer();
+    MeshBuffer(const MeshBuffer &) = delete;
+    MeshBuffer &operator=(const MeshBuffer &) = delete;
+
+    // uploads a mesh behind the previous ones and returns where it went
+    MeshBufferRange append(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices, unsigned int texture_layer = 0);
+
+    unsigned int get_vao() const { return VAO; }
+    GLenum get_index_type() const { return index_type; }
+
+private:
+    unsigned int VAO;
+    unsigned int VBO;
+    unsigned int EBO;
+    // 16 bit layer per vertex, 0 without texture_layers
+    unsigned int layer_VBO = 0;
+    GLenum index_type;
+    Vertex_Format format;
+    glm::vec3 position_offset = glm::vec3(0.0f);
+    glm::vec3 position_scale = glm::vec3(1.0f);
+
+    // space used so far, in vertices and indices
+    size_t vertex_count = 0;
+    size_t index_count = 0;
+    size_t vertex_capacity;
+    size_t index_capacity;
+};
+
+#endif
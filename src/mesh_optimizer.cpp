@@ -0,0 +1,358 @@
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+VertexCacheStats analyze_vertex_cache(const std::vector<unsigned int> &indices, size_t vertex_count, unsigned int cache_size)
+{
+    VertexCacheStats stats;
+    // without a complete triangle the ratios are 0 / 0
+    if (indices.size() < 3 || vertex_count == 0)
+    {
+        return stats;
+    }
+
+    // a vertex is in the cache while fewer than cache_size misses happened since it was last loaded
+    std::vector<size_t> loaded_at(vertex_count, 0);
+    std::vector<bool> referenced(vertex_count, false);
+    size_t misses = 0;
+    size_t n_referenced = 0;
+
+    for (unsigned int index : indices)
+    {
+        if (!referenced[index])
+        {
+            referenced[index] = true;
+            n_referenced++;
+            loaded_at[index] = ++misses;
+        }
+        else if (misses - loaded_at[index] >= cache_size)
+        {
+            loaded_at[index] = ++misses;
+        }
+    }
+
+    stats.acmr = float(misses) / float(indices.size() / 3);
+    stats.atvr = float(misses) / float(n_referenced);
+    return stats;
+}
+
+void optimize_vertex_cache(std::vector<unsigned int> &indices, size_t vertex_count, std::vector<unsigned int> *clusters, unsigned int cache_size)
+{
+    size_t n_triangles = indices.size() / 3;
+    if (clusters)
+    {
+        clusters->clear();
+    }
+    if (n_triangles == 0)
+    {
+        return;
+    }
+
+    // vertex -> triangle adjacency in compressed rows
+    std::vector<unsigned int> live(vertex_count, 0);
+    for (unsigned int index : indices)
+    {
+        live[index]++;
+    }
+    std::vector<unsigned int> offsets(vertex_count + 1, 0);
+    for (size_t v = 0; v < vertex_count; v++)
+    {
+        offsets[v + 1] = offsets[v] + live[v];
+    }
+    std::vector<unsigned int> adjacency(indices.size());
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        adjacency[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+    }
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    std::vector<bool> emitted(n_triangles, false);
+    std::vector<size_t> cache_time(vertex_count, 0);
+    std::vector<unsigned int> dead_end;
+    std::vector<unsigned int> candidates;
+    size_t time = cache_size + 1;
+    size_t cursor = 0;
+    long long fan = 0;
+    bool new_cluster = true;
+
+    while (fan >= 0)
+    {
+        if (new_cluster && clusters && (clusters->empty() || clusters->back() != result.size()))
+        {
+            clusters->push_back(static_cast<unsigned int>(result.size()));
+        }
+
+        // emit every remaining triangle around the fanning vertex
+        candidates.clear();
+        for (unsigned int k = offsets[fan]; k < offsets[fan + 1]; k++)
+        {
+            unsigned int triangle = adjacency[k];
+            if (emitted[triangle])
+            {
+                continue;
+            }
+            emitted[triangle] = true;
+
+            for (int corner = 0; corner < 3; corner++)
+            {
+                unsigned int v = indices[triangle * 3 + corner];
+                result.push_back(v);
+                dead_end.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - cache_time[v] > cache_size)
+                {
+                    cache_time[v] = time++;
+                }
+            }
+        }
+
+        // next fan: the candidate that stays in the cache the longest while it still has triangles left
+        long long next = -1;
+        long long best_priority = -1;
+        for (unsigned int v : candidates)
+        {
+            if (live[v] == 0)
+            {
+                continue;
+            }
+            long long priority = 0;
+            if (time - cache_time[v] + 2 * live[v] <= cache_size)
+            {
+                priority = static_cast<long long>(time - cache_time[v]);
+            }
+            if (priority > best_priority)
+            {
+                best_priority = priority;
+                next = v;
+            }
+        }
+
+        new_cluster = next < 0;
+        if (next < 0)
+        {
+            // dead end, back up through recently used vertices and then fall back to scanning in input order
+            while (!dead_end.empty() && next < 0)
+            {
+                unsigned int v = dead_end.back();
+                dead_end.pop_back();
+                if (live[v] > 0)
+                {
+                    next = v;
+                }
+            }
+            while (next < 0 && cursor < vertex_count)
+            {
+                if (live[cursor] > 0)
+                {
+                    next = static_cast<long long>(cursor);
+                }
+                cursor++;
+            }
+        }
+        fan = next;
+    }
+
+    indices.swap(result);
+}
+
+void optimize_overdraw(std::vector<unsigned int> &indices, const std::vector<Vertex> &vertices, const std::vector<unsigned int> &clusters, float threshold)
+{
+    if (clusters.size() < 2)
+    {
+        return;
+    }
+
+    struct Cluster
+    {
+        unsigned int begin;
+        unsigned int end;
+        glm::vec3 centroid;
+        glm::vec3 normal;
+        float sort_key;
+    };
+
+    // area weighted centroid and normal per cluster
+    std::vector<Cluster> sorted(clusters.size());
+    glm::vec3 mesh_centroid(0.0f);
+    float mesh_area = 0.0f;
+    for (size_t c = 0; c < clusters.size(); c++)
+    {
+        Cluster &cluster = sorted[c];
+        cluster.begin = clusters[c];
+        cluster.end = c + 1 < clusters.size() ? clusters[c + 1] : static_cast<unsigned int>(indices.size());
+        cluster.centroid = glm::vec3(0.0f);
+        cluster.normal = glm::vec3(0.0f);
+
+        float area = 0.0f;
+        for (unsigned int i = cluster.begin; i < cluster.end; i += 3)
+        {
+            const glm::vec3 &a = vertices[indices[i]].position;
+            const glm::vec3 &b = vertices[indices[i + 1]].position;
+            const glm::vec3 &d = vertices[indices[i + 2]].position;
+            glm::vec3 cross = glm::cross(b - a, d - a);
+            float triangle_area = glm::length(cross) * 0.5f;
+            cluster.centroid += (a + b + d) * (triangle_area / 3.0f);
+            cluster.normal += cross;
+            area += triangle_area;
+        }
+
+        mesh_centroid += cluster.centroid;
+        mesh_area += area;
+        cluster.centroid = area > 0.0f ? cluster.centroid / area : vertices[indices[cluster.begin]].position;
+        float length = glm::length(cluster.normal);
+        cluster.normal = length > 0.0f ? cluster.normal / length : glm::vec3(0.0f);
+    }
+    if (mesh_area > 0.0f)
+    {
+        mesh_centroid /= mesh_area;
+    }
+
+    for (Cluster &cluster : sorted)
+    {
+        cluster.sort_key = glm::dot(cluster.centroid - mesh_centroid, cluster.normal);
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster &a, const Cluster &b)
+                     { return a.sort_key > b.sort_key; });
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    for (const Cluster &cluster : sorted)
+    {
+        result.insert(result.end(), indices.begin() + cluster.begin, indices.begin() + cluster.end);
+    }
+
+    // moving clusters apart costs cache hits at their seams, only keep the new order if that cost is small
+    VertexCacheStats current = analyze_vertex_cache(indices, vertices.size());
+    VertexCacheStats reordered = analyze_vertex_cache(result, vertices.size());
+    if (reordered.acmr <= current.acmr * threshold)
+    {
+        indices.swap(result);
+    }
+}
+
+void optimize_vertex_fetch(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
+{
+    const unsigned int unused = ~0u;
+    std::vector<unsigned int> remap(vertices.size(), unused);
+    std::vector<Vertex> result;
+    result.reserve(vertices.size());
+
+    for (unsigned int &index : indices)
+    {
+        if (remap[index] == unused)
+        {
+            remap[index] = static_cast<unsigned int>(result.size());
+            result.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    vertices.swap(result);
+}
+
+std::vector<MeshData> split_mesh(MeshData &mesh, size_t max_vertices)
+{
+    std::vector<MeshData> chunks;
+    if (mesh.vertices.size() <= max_vertices || mesh.indices.size() % 3 != 0)
+    {
+        chunks.push_back(std::move(mesh));
+        return chunks;
+    }
+
+    // greedily fill chunks in triangle order, remap holds the chunk local index of every vertex in the current chunk
+    const unsigned int unused = ~0u;
+    std::vector<unsigned int> remap(mesh.vertices.size(), unused);
+    std::vector<unsigned int> chunk_vertices;
+    MeshData chunk;
+    chunk.material = mesh.material;
+
+    for (size_t i = 0; i < mesh.indices.size(); i += 3)
+    {
+        size_t new_vertices = 0;
+        for (size_t corner = 0; corner < 3; corner++)
+        {
+            new_vertices += remap[mesh.indices[i + corner]] == unused;
+        }
+        if (chunk.vertices.size() + new_vertices > max_vertices)
+        {
+            for (unsigned int v : chunk_vertices)
+            {
+                remap[v] = unused;
+            }
+            chunk_vertices.clear();
+            chunk.bounds = compute_bounds(chunk.vertices);
+            chunks.push_back(std::move(chunk));
+            chunk = MeshData();
+            chunk.material = mesh.material;
+        }
+
+        for (size_t corner = 0; corner < 3; corner++)
+        {
+            unsigned int v = mesh.indices[i + corner];
+            if (remap[v] == unused)
+            {
+                remap[v] = static_cast<unsigned int>(chunk.vertices.size());
+                chunk.vertices.push_back(mesh.vertices[v]);
+                chunk_vertices.push_back(v);
+            }
+            chunk.indices.push_back(remap[v]);
+        }
+    }
+    if (!chunk.indices.empty())
+    {
+        chunk.bounds = compute_bounds(chunk.vertices);
+        chunks.push_back(std::move(chunk));
+    }
+
+    mesh = MeshData();
+    return chunks;
+}
+
+MeshOptimizationReport optimize_mesh(MeshData &mesh, bool overdraw)
+{
+    MeshOptimizationReport report;
+
+    // only triangle lists are handled, leave anything with points or lines alone
+    if (mesh.indices.size() % 3 != 0)
+    {
+        report.before = report.after = analyze_vertex_cache(mesh.indices, mesh.vertices.size());
+        return report;
+    }
+
+    // every level of detail is drawn on its own, so each index range is reordered separately
+    std::vector<MeshLod> lods = mesh.lods;
+    if (lods.empty())
+    {
+        lods.push_back({0, static_cast<unsigned int>(mesh.indices.size()), 0.0f});
+    }
+
+    std::vector<unsigned int> clusters;
+    for (size_t lod = 0; lod < lods.size(); lod++)
+    {
+        std::vector<unsigned int> range(mesh.indices.begin() + lods[lod].first_index,
+                                        mesh.indices.begin() + lods[lod].first_index + lods[lod].index_count);
+        if (lod == 0)
+        {
+            report.before = analyze_vertex_cache(range, mesh.vertices.size());
+        }
+
+        optimize_vertex_cache(range, mesh.vertices.size(), overdraw ? &clusters : nullptr);
+        if (overdraw)
+        {
+            optimize_overdraw(range, mesh.vertices, clusters);
+        }
+        std::copy(range.begin(), range.end(), mesh.indices.begin() + lods[lod].first_index);
+    }
+
+    // the finest level comes first in the index array and references every vertex, so its fetch order wins
+    optimize_vertex_fetch(mesh.vertices, mesh.indices);
+
+    report.after = analyze_vertex_cache(std::vector<unsigned int>(mesh.indices.begin(), mesh.indices.begin() + lods[0].index_count),
+                                        mesh.vertices.size());
+    return report;
+}
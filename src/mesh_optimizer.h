@@ -0,0 +1,54 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <vector>
+
+#include "mesh.h"
+#include "model_data.h"
+
+// Import-time reordering of triangle lists for the GPU's post-transform vertex cache, overdraw and vertex fetch.
+// Everything here is plain CPU work on indexed triangle lists and can be checked with the cache simulator.
+
+// number of entries of the simulated FIFO post-transform cache
+const unsigned int vertex_cache_size = 16;
+
+struct VertexCacheStats
+{
+    // average cache miss ratio, transformed vertices per triangle (0.5 is ideal on large meshes, 3 is worst)
+    float acmr = 0.0f;
+    // average transformed to vertex ratio, transformed vertices per referenced vertex (1 is ideal)
+    float atvr = 0.0f;
+};
+
+struct MeshOptimizationReport
+{
+    VertexCacheStats before;
+    VertexCacheStats after;
+};
+
+// simulates a FIFO cache of cache_size entries running over the triangle list, all zero without a complete triangle
+VertexCacheStats analyze_vertex_cache(const std::vector<unsigned int> &indices, size_t vertex_count, unsigned int cache_size = vertex_cache_size);
+
+// reorders triangles for cache hits with Tipsify (Sander et al. 2007). If clusters is given it receives the first index
+// of every run of triangles that started at a dead end, these are the units optimize_overdraw is allowed to move around.
+void optimize_vertex_cache(std::vector<unsigned int> &indices, size_t vertex_count, std::vector<unsigned int> *clusters = nullptr,
+                           unsigned int cache_size = vertex_cache_size);
+
+// sorts the clusters from optimize_vertex_cache so outward facing ones on the hull come first, which lets early depth testing
+// reject more of the rest from any viewpoint. The new order is only kept if its ACMR stays within threshold times the input's.
+void optimize_overdraw(std::vector<unsigned int> &indices, const std::vector<Vertex> &vertices, const std::vector<unsigned int> &clusters,
+                       float threshold = 1.05f);
+
+// renumbers vertices in order of first use so vertex fetch walks memory linearly, unreferenced vertices are dropped
+void optimize_vertex_fetch(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices);
+
+// splits a mesh into chunks of at most max_vertices vertices each, keeping the triangle order, so every chunk
+// can use 16 bit indices. The mesh is moved from, one that is small enough already comes back as the only chunk.
+// Meant to run before generate_lods, chunks of a split mesh come without levels of detail.
+std::vector<MeshData> split_mesh(MeshData &mesh, size_t max_vertices = 65536);
+
+// runs the passes above on a mesh, reorders for overdraw too if requested. Every level of detail in mesh.lods is
+// reordered on its own, the report covers the finest level.
+MeshOptimizationReport optimize_mesh(MeshData &mesh, bool overdraw);
+
+#endif
@@ -0,0 +1,503 @@
+#include "mesh_simplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <glm/glm.hpp>
+
+namespace
+{
+    // symmetric 4x4 error quadric, weight is the summed weight of the planes so errors can be normalized to distances
+    struct Quadric
+    {
+        double a2 = 0.0, ab = 0.0, ac = 0.0, ad = 0.0;
+        double b2 = 0.0, bc = 0.0, bd = 0.0;
+        double c2 = 0.0, cd = 0.0;
+        double d2 = 0.0;
+        double weight = 0.0;
+
+        void add_plane(const glm::dvec3 &n, double d, double w)
+        {
+            a2 += w * n.x * n.x;
+            ab += w * n.x * n.y;
+            ac += w * n.x * n.z;
+            ad += w * n.x * d;
+            b2 += w * n.y * n.y;
+            bc += w * n.y * n.z;
+            bd += w * n.y * d;
+            c2 += w * n.z * n.z;
+            cd += w * n.z * d;
+            d2 += w * d * d;
+            weight += w;
+        }
+
+        void add(const Quadric &q)
+        {
+            a2 += q.a2;
+            ab += q.ab;
+            ac += q.ac;
+            ad += q.ad;
+            b2 += q.b2;
+            bc += q.bc;
+            bd += q.bd;
+            c2 += q.c2;
+            cd += q.cd;
+            d2 += q.d2;
+            weight += q.weight;
+        }
+
+        // weighted mean squared distance of p to the planes
+        double evaluate(const glm::dvec3 &p) const
+        {
+            double r = a2 * p.x * p.x + 2.0 * ab * p.x * p.y + 2.0 * ac * p.x * p.z + 2.0 * ad * p.x + b2 * p.y * p.y + 2.0 * bc * p.y * p.z +
+                       2.0 * bd * p.y + c2 * p.z * p.z + 2.0 * cd * p.z + d2;
+            return weight > 0.0 ? std::abs(r) / weight : 0.0;
+        }
+    };
+
+    enum Vertex_Kind
+    {
+        // interior vertex without attribute seams, may collapse onto any neighbour
+        MANIFOLD,
+        // on an open border, may only collapse along the border
+        BORDER,
+        // two copies with different attributes along a seam, may only collapse along the seam
+        SEAM,
+        // anything more complex, never moves
+        LOCKED
+    };
+
+    // edge planes are weighted heavily so borders and seams keep their shape
+    const double boundary_weight = 10.0;
+    const unsigned int none = ~0u;
+
+    struct PositionKey
+    {
+        uint32_t bits[3];
+
+        bool operator==(const PositionKey &other) const
+        {
+            return bits[0] == other.bits[0] && bits[1] == other.bits[1] && bits[2] == other.bits[2];
+        }
+    };
+
+    struct PositionHash
+    {
+        size_t operator()(const PositionKey &key) const
+        {
+            return (key.bits[0] * 73856093u) ^ (key.bits[1] * 19349663u) ^ (key.bits[2] * 83492791u);
+        }
+    };
+
+    uint64_t edge_key(unsigned int a, unsigned int b)
+    {
+        return (uint64_t(a) << 32) | b;
+    }
+
+    struct Collapse
+    {
+        unsigned int from;
+        unsigned int to;
+        double cost;
+    };
+}
+
+std::vector<unsigned int> simplify_mesh(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices, size_t target_index_count,
+                                        float &error)
+{
+    error = 0.0f;
+    std::vector<unsigned int> result = indices;
+    if (indices.size() % 3 != 0 || indices.size() <= target_index_count)
+    {
+        return result;
+    }
+
+    // vertices sharing a position form one position class, identified by its first vertex
+    size_t n_vertices = vertices.size();
+    std::vector<unsigned int> position_of(n_vertices);
+    {
+        std::unordered_map<PositionKey, unsigned int, PositionHash> first;
+        for (unsigned int v = 0; v < n_vertices; v++)
+        {
+            PositionKey key;
+            std::memcpy(key.bits, &vertices[v].position, sizeof(key.bits));
+            position_of[v] = first.emplace(key, v).first->second;
+        }
+    }
+
+    std::vector<Quadric> quadrics(n_vertices);
+    std::vector<Vertex_Kind> kind(n_vertices);
+    std::vector<unsigned int> border_next(n_vertices), border_prev(n_vertices);
+    std::vector<unsigned int> seam_next(n_vertices), seam_prev(n_vertices), first_copy(n_vertices), other_copy(n_vertices);
+    std::vector<unsigned int> open_out(n_vertices), open_in(n_vertices), seam_out(n_vertices), seam_in(n_vertices), copies(n_vertices);
+    std::vector<unsigned int> collapsed_to(n_vertices, none);
+    std::vector<bool> locked(n_vertices);
+    std::vector<unsigned int> triangle_offsets(n_vertices + 1);
+    std::vector<unsigned int> triangles;
+    std::unordered_set<uint64_t> index_edges, position_edges;
+    double max_cost = 0.0;
+    bool first_pass = true;
+
+    auto position = [&](unsigned int v)
+    {
+        return glm::dvec3(vertices[v].position);
+    };
+
+    while (result.size() > target_index_count)
+    {
+        // topology of the current triangles, by index and by position
+        index_edges.clear();
+        position_edges.clear();
+        std::fill(copies.begin(), copies.end(), 0);
+        std::fill(first_copy.begin(), first_copy.end(), none);
+        std::fill(other_copy.begin(), other_copy.end(), none);
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int a = result[i + k];
+                unsigned int b = result[i + (k + 1) % 3];
+                index_edges.insert(edge_key(a, b));
+                position_edges.insert(edge_key(position_of[a], position_of[b]));
+            }
+        }
+
+        std::vector<bool> referenced(n_vertices, false);
+        for (unsigned int v : result)
+        {
+            if (referenced[v])
+            {
+                continue;
+            }
+            referenced[v] = true;
+
+            // only position classes with exactly two copies can be seams, link those copies to each other
+            unsigned int p = position_of[v];
+            if (copies[p]++ == 0)
+            {
+                first_copy[p] = v;
+            }
+            else if (copies[p] == 2)
+            {
+                other_copy[v] = first_copy[p];
+                other_copy[first_copy[p]] = v;
+            }
+        }
+
+        std::fill(open_out.begin(), open_out.end(), 0);
+        std::fill(open_in.begin(), open_in.end(), 0);
+        std::fill(seam_out.begin(), seam_out.end(), 0);
+        std::fill(seam_in.begin(), seam_in.end(), 0);
+        for (uint64_t edge : position_edges)
+        {
+            unsigned int a = unsigned(edge >> 32), b = unsigned(edge & 0xffffffffu);
+            if (!position_edges.count(edge_key(b, a)))
+            {
+                open_out[a]++;
+                open_in[b]++;
+                border_next[a] = b;
+                border_prev[b] = a;
+            }
+        }
+        for (uint64_t edge : index_edges)
+        {
+            unsigned int a = unsigned(edge >> 32), b = unsigned(edge & 0xffffffffu);
+            // open by index but closed by position: the neighbouring triangle uses another copy, an attribute seam
+            if (!index_edges.count(edge_key(b, a)) && position_edges.count(edge_key(position_of[b], position_of[a])))
+            {
+                seam_out[a]++;
+                seam_in[b]++;
+                seam_next[a] = b;
+                seam_prev[b] = a;
+            }
+        }
+
+        for (unsigned int v = 0; v < n_vertices; v++)
+        {
+            unsigned int p = position_of[v];
+            if (!referenced[v])
+            {
+                kind[v] = LOCKED;
+            }
+            else if (copies[p] == 1 && seam_out[v] == 0 && seam_in[v] == 0)
+            {
+                if (open_out[p] == 0 && open_in[p] == 0)
+                {
+                    kind[v] = MANIFOLD;
+                }
+                else
+                {
+                    kind[v] = open_out[p] == 1 && open_in[p] == 1 ? BORDER : LOCKED;
+                }
+            }
+            else if (copies[p] == 2 && open_out[p] == 0 && open_in[p] == 0)
+            {
+                unsigned int w = other_copy[v];
+                bool simple = seam_out[v] == 1 && seam_in[v] == 1 && seam_out[w] == 1 && seam_in[w] == 1;
+                kind[v] = simple ? SEAM : LOCKED;
+            }
+            else
+            {
+                kind[v] = LOCKED;
+            }
+        }
+
+        // quadrics come from the input triangles only and are merged as vertices collapse
+        if (first_pass)
+        {
+            first_pass = false;
+            for (size_t i = 0; i < result.size(); i += 3)
+            {
+                glm::dvec3 p0 = position(result[i]), p1 = position(result[i + 1]), p2 = position(result[i + 2]);
+                glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+                double length = glm::length(normal);
+                if (length <= 0.0)
+                {
+                    continue;
+                }
+                normal /= length;
+                double area = length * 0.5;
+
+                for (int k = 0; k < 3; k++)
+                {
+                    unsigned int a = result[i + k];
+                    unsigned int b = result[i + (k + 1) % 3];
+                    quadrics[position_of[a]].add_plane(normal, -glm::dot(normal, position(a)), area);
+
+                    bool border = !position_edges.count(edge_key(position_of[b], position_of[a]));
+                    bool seam = !border && !index_edges.count(edge_key(b, a));
+                    if (border || seam)
+                    {
+                        glm::dvec3 edge = position(b) - position(a);
+                        glm::dvec3 edge_normal = glm::cross(edge, normal);
+                        double edge_length = glm::length(edge_normal);
+                        if (edge_length > 0.0)
+                        {
+                            edge_normal /= edge_length;
+                            double d = -glm::dot(edge_normal, position(a));
+                            double weight = glm::dot(edge, edge) * boundary_weight;
+                            quadrics[position_of[a]].add_plane(edge_normal, d, weight);
+                            quadrics[position_of[b]].add_plane(edge_normal, d, weight);
+                        }
+                    }
+                }
+            }
+        }
+
+        // triangles around every position class
+        std::fill(triangle_offsets.begin(), triangle_offsets.end(), 0);
+        for (unsigned int v : result)
+        {
+            triangle_offsets[position_of[v] + 1]++;
+        }
+        for (size_t p = 0; p < n_vertices; p++)
+        {
+            triangle_offsets[p + 1] += triangle_offsets[p];
+        }
+        triangles.resize(result.size());
+        std::vector<unsigned int> fill(triangle_offsets.begin(), triangle_offsets.end() - 1);
+        for (size_t i = 0; i < result.size(); i++)
+        {
+            triangles[fill[position_of[result[i]]]++] = static_cast<unsigned int>(i / 3);
+        }
+
+        // finds the vertex the other seam copy has to collapse onto, none if the collapse is not allowed
+        auto allowed = [&](unsigned int from, unsigned int to, unsigned int &paired_to)
+        {
+            paired_to = none;
+            unsigned int from_position = position_of[from], to_position = position_of[to];
+            switch (kind[from])
+            {
+            case MANIFOLD:
+                return true;
+            case BORDER:
+                return border_next[from_position] == to_position || border_prev[from_position] == to_position;
+            case SEAM:
+            {
+                if (seam_next[from] != to && seam_prev[from] != to)
+                {
+                    return false;
+                }
+                unsigned int w = other_copy[from];
+                if (position_of[seam_next[w]] == to_position)
+                {
+                    paired_to = seam_next[w];
+                }
+                else if (position_of[seam_prev[w]] == to_position)
+                {
+                    paired_to = seam_prev[w];
+                }
+                return paired_to != none;
+            }
+            default:
+                return false;
+            }
+        };
+
+        // moving from onto to must not flip any of the remaining triangles around it
+        auto flips = [&](unsigned int from, unsigned int to)
+        {
+            unsigned int from_position = position_of[from], to_position = position_of[to];
+            glm::dvec3 target = position(to);
+            for (unsigned int k = triangle_offsets[from_position]; k < triangle_offsets[from_position + 1]; k++)
+            {
+                const unsigned int *corner = &result[triangles[k] * 3];
+                glm::dvec3 p[3];
+                bool has_target = false;
+                for (int c = 0; c < 3; c++)
+                {
+                    p[c] = position(corner[c]);
+                    has_target = has_target || position_of[corner[c]] == to_position;
+                }
+                if (has_target)
+                {
+                    continue;
+                }
+
+                glm::dvec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                for (int c = 0; c < 3; c++)
+                {
+                    if (position_of[corner[c]] == from_position)
+                    {
+                        p[c] = target;
+                    }
+                }
+                // reject flipped triangles and ones that would turn by more than ~75 degrees, those become slivers and fins
+                glm::dvec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+                if (glm::dot(before, after) <= 0.25 * glm::length(before) * glm::length(after))
+                {
+                    return true;
+                }
+            }
+            return false;
+        };
+
+        std::vector<Collapse> candidates;
+        candidates.reserve(result.size() * 2);
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int a = result[i + k];
+                unsigned int b = result[i + (k + 1) % 3];
+                unsigned int paired;
+                if (allowed(a, b, paired))
+                {
+                    candidates.push_back({a, b, quadrics[position_of[a]].evaluate(position(b))});
+                }
+                if (allowed(b, a, paired))
+                {
+                    candidates.push_back({b, a, quadrics[position_of[b]].evaluate(position(a))});
+                }
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const Collapse &x, const Collapse &y)
+                  { return x.cost < y.cost; });
+
+        // apply the cheapest independent collapses, everything around a collapse is locked for the rest of the pass
+        std::fill(locked.begin(), locked.end(), false);
+        size_t triangles_left = result.size() / 3;
+        size_t target_triangles = target_index_count / 3;
+        size_t n_collapses = 0;
+        for (const Collapse &collapse : candidates)
+        {
+            if (triangles_left <= target_triangles)
+            {
+                break;
+            }
+
+            unsigned int from_position = position_of[collapse.from], to_position = position_of[collapse.to];
+            unsigned int paired;
+            if (locked[from_position] || locked[to_position] || !allowed(collapse.from, collapse.to, paired) || flips(collapse.from, collapse.to))
+            {
+                continue;
+            }
+
+            collapsed_to[collapse.from] = collapse.to;
+            if (paired != none)
+            {
+                collapsed_to[other_copy[collapse.from]] = paired;
+            }
+            quadrics[to_position].add(quadrics[from_position]);
+            max_cost = std::max(max_cost, collapse.cost);
+            n_collapses++;
+            triangles_left -= kind[collapse.from] == BORDER ? 1 : 2;
+
+            for (unsigned int k = triangle_offsets[from_position]; k < triangle_offsets[from_position + 1]; k++)
+            {
+                for (int c = 0; c < 3; c++)
+                {
+                    locked[position_of[result[triangles[k] * 3 + c]]] = true;
+                }
+            }
+        }
+
+        if (n_collapses == 0)
+        {
+            break;
+        }
+
+        // rewrite the triangles and drop the ones that became degenerate
+        size_t write = 0;
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            unsigned int corner[3];
+            for (int c = 0; c < 3; c++)
+            {
+                unsigned int v = result[i + c];
+                corner[c] = collapsed_to[v] != none ? collapsed_to[v] : v;
+            }
+            unsigned int p0 = position_of[corner[0]], p1 = position_of[corner[1]], p2 = position_of[corner[2]];
+            if (p0 == p1 || p1 == p2 || p2 == p0)
+            {
+                continue;
+            }
+            result[write++] = corner[0];
+            result[write++] = corner[1];
+            result[write++] = corner[2];
+        }
+        result.resize(write);
+        std::fill(collapsed_to.begin(), collapsed_to.end(), none);
+    }
+
+    error = static_cast<float>(std::sqrt(max_cost));
+    return result;
+}
+
+void generate_lods(MeshData &mesh, unsigned int max_levels, size_t min_triangles)
+{
+    mesh.lods.clear();
+    mesh.lods.push_back({0, static_cast<unsigned int>(mesh.indices.size()), 0.0f});
+    if (mesh.indices.size() % 3 != 0)
+    {
+        return;
+    }
+
+    // every level is simplified from the previous one, so its error bound is the sum of the steps so far
+    std::vector<unsigned int> previous = mesh.indices;
+    float error = 0.0f;
+    for (unsigned int level = 1; level <= max_levels; level++)
+    {
+        size_t target = previous.size() / 6 * 3;
+        if (target / 3 < min_triangles)
+        {
+            break;
+        }
+
+        float step_error;
+        std::vector<unsigned int> lod = simplify_mesh(mesh.vertices, previous, target, step_error);
+        if (lod.empty() || lod.size() > previous.size() * 9 / 10)
+        {
+            break;
+        }
+        error += step_error;
+
+        mesh.lods.push_back({static_cast<unsigned int>(mesh.indices.size()), static_cast<unsigned int>(lod.size()), error});
+        mesh.indices.insert(mesh.indices.end(), lod.begin(), lod.end());
+        previous.swap(lod);
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <vector>
+
+#include "mesh.h"
+#include "model_data.h"
+
+// Quadric error edge collapse simplification (Garland and Heckbert) for building level of detail chains.
+// Vertices only ever collapse onto other existing vertices, so every level indexes into the original vertex array
+// and all levels of a mesh can share one vertex buffer. Vertices with the same position but different attributes
+// (UV seams, hard normals) only collapse along the seam, both copies at once, and open borders only collapse along
+// the border, so neither seams nor silhouettes of open meshes tear apart.
+
+// simplifies the triangle list down to roughly target_index_count indices, or less if that can't be reached without
+// breaking the rules above. error receives the largest approximation error introduced, in object space units.
+std::vector<unsigned int> simplify_mesh(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices, size_t target_index_count,
+                                        float &error);
+
+// appends successively halved levels to mesh.indices and fills mesh.lods, level 0 being the input triangles.
+// Stops after max_levels extra levels, below min_triangles or once a level doesn't reduce the triangle count much anymore.
+void generate_lods(MeshData &mesh, unsigned int max_levels = 4, size_t min_triangles = 64);
+
+#endif
@@ -0,0 +1,285 @@
+#include "mip_generator.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "thread_pool.h"
+
+#if defined(__SSE2__)
+#define MIP_GENERATOR_SIMD 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // resolution of the linear to sRGB table, fine enough that the steps stay below a fifth of an 8 bit step
+    const int linear_steps = 16384;
+
+    struct SrgbTables
+    {
+        float to_linear[256];
+        unsigned char to_srgb[linear_steps];
+
+        SrgbTables()
+        {
+            for (int i = 0; i < 256; i++)
+            {
+                float value = i / 255.0f;
+                to_linear[i] = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+            }
+            for (int i = 0; i < linear_steps; i++)
+            {
+                float value = i / float(linear_steps - 1);
+                float srgb = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+                to_srgb[i] = static_cast<unsigned char>(std::lround(srgb * 255.0f));
+            }
+        }
+    };
+
+    const SrgbTables &srgb_tables()
+    {
+        static const SrgbTables tables;
+        return tables;
+    }
+
+    // 4 floats per pixel no matter how many channels the image has, so a pixel is one SIMD register
+    struct FloatImage
+    {
+        int width = 0;
+        int height = 0;
+        std::vector<float> pixels;
+    };
+
+    // how every channel is stored in 8 bits
+    enum Encoding
+    {
+        UNORM,
+        SRGB,
+        SNORM_VECTOR
+    };
+
+    Encoding channel_encoding(int channel, bool srgb, bool normal_map)
+    {
+        if (channel == 3)
+        {
+            return UNORM;
+        }
+        return normal_map ? SNORM_VECTOR : srgb ? SRGB : UNORM;
+    }
+
+    // one row of 8 bit pixels as 4 floats per pixel, decoded according to the channel encodings
+    void to_float(const unsigned char *source, int width, int n_components, bool srgb, bool normal_map, float *target)
+    {
+        const SrgbTables &tables = srgb_tables();
+        for (int x = 0; x < width; x++, source += n_components, target += 4)
+        {
+            target[0] = target[1] = target[2] = 0.0f;
+            target[3] = 1.0f;
+            for (int c = 0; c < n_components; c++)
+            {
+                switch (channel_encoding(c, srgb, normal_map))
+                {
+                case SRGB:
+                    target[c] = tables.to_linear[source[c]];
+                    break;
+                case SNORM_VECTOR:
+                    target[c] = source[c] * (2.0f / 255.0f) - 1.0f;
+                    break;
+                default:
+                    target[c] = source[c] * (1.0f / 255.0f);
+                    break;
+                }
+            }
+        }
+    }
+
+    void to_bytes(const FloatImage &image, int n_components, bool srgb, bool normal_map, std::vector<unsigned char> &out)
+    {
+        const SrgbTables &tables = srgb_tables();
+        out.resize(size_t(image.width) * image.height * n_components);
+        ThreadPool::shared().parallel_for(image.height, [&](size_t y)
+                                          {
+                                              const float *source = image.pixels.data() + y * image.width * 4;
+                                              unsigned char *target = out.data() + y * image.width * n_components;
+                                              for (int x = 0; x < image.width; x++, source += 4, target += n_components)
+                                              {
+                                                  for (int c = 0; c < n_components; c++)
+                                                  {
+                                                      float value = source[c];
+                                                      switch (channel_encoding(c, srgb, normal_map))
+                                                      {
+                                                      case SRGB:
+                                                          value = std::min(std::max(value, 0.0f), 1.0f);
+                                                          target[c] = tables.to_srgb[int(value * (linear_steps - 1) + 0.5f)];
+                                                          break;
+                                                      case SNORM_VECTOR:
+                                                          value = std::min(std::max(value * 0.5f + 0.5f, 0.0f), 1.0f);
+                                                          target[c] = static_cast<unsigned char>(value * 255.0f + 0.5f);
+                                                          break;
+                                                      default:
+                                                          value = std::min(std::max(value, 0.0f), 1.0f);
+                                                          target[c] = static_cast<unsigned char>(value * 255.0f + 0.5f);
+                                                          break;
+                                                      }
+                                                  }
+                                              }
+                                          });
+    }
+
+    // Source pixels an output pixel of the next level covers along one axis, with their weights. Even sizes halve
+    // with a 2 tap box. Odd ones use a 3 tap 1/4, 1/2, 1/4 tent that overlaps its neighbors by one pixel, so the
+    // last row or column isn't dropped; the weights aren't polyphase, so pixels don't all contribute equally.
+    int footprint(int size, int i, int index[3], float weight[3])
+    {
+        if (size == 1)
+        {
+            index[0] = 0;
+            weight[0] = 1.0f;
+            return 1;
+        }
+        if (size % 2 == 0)
+        {
+            index[0] = i * 2;
+            index[1] = i * 2 + 1;
+            weight[0] = weight[1] = 0.5f;
+            return 2;
+        }
+        index[0] = i * 2;
+        index[1] = i * 2 + 1;
+        index[2] = i * 2 + 2;
+        weight[0] = weight[2] = 0.25f;
+        weight[1] = 0.5f;
+        return 3;
+    }
+
+    // The next smaller level of a width x height image whose rows, 4 floats per pixel, come from row(y, scratch).
+    // The callback either points into a float image or decodes 8 bit pixels into scratch, so the first level never
+    // needs a float copy of the full resolution source.
+    template <typename RowSource>
+    void downsample(int width, int height, const RowSource &row, bool normal_map, FloatImage &out)
+    {
+        out.width = std::max(width / 2, 1);
+        out.height = std::max(height / 2, 1);
+        out.pixels.resize(size_t(out.width) * out.height * 4);
+        ThreadPool::shared().parallel_for(out.height, [&](size_t y)
+                                          {
+                                              thread_local std::vector<float> scratch;
+                                              scratch.resize(size_t(width) * 4 * 3);
+
+                                              int row_index[3];
+                                              float row_weight[3];
+                                              int rows = footprint(height, int(y), row_index, row_weight);
+                                              const float *source_rows[3];
+                                              for (int r = 0; r < rows; r++)
+                                              {
+                                                  source_rows[r] = row(row_index[r], scratch.data() + size_t(width) * 4 * r);
+                                              }
+
+                                              float *target = out.pixels.data() + y * out.width * 4;
+                                              for (int x = 0; x < out.width; x++, target += 4)
+                                              {
+                                                  int column_index[3];
+                                                  float column_weight[3];
+                                                  int columns = footprint(width, x, column_index, column_weight);
+#ifdef MIP_GENERATOR_SIMD
+                                                  __m128 average = _mm_setzero_ps();
+                                                  for (int r = 0; r < rows; r++)
+                                                  {
+                                                      for (int c = 0; c < columns; c++)
+                                                      {
+                                                          __m128 pixel = _mm_loadu_ps(source_rows[r] + size_t(column_index[c]) * 4);
+                                                          average = _mm_add_ps(average, _mm_mul_ps(pixel, _mm_set1_ps(row_weight[r] * column_weight[c])));
+                                                      }
+                                                  }
+                                                  if (normal_map)
+                                                  {
+                                                      // length of xyz in every lane, w is left as it is
+                                                      const __m128 xyz = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+                                                      __m128 squares = _mm_and_ps(_mm_mul_ps(average, average), xyz);
+                                                      __m128 length = _mm_add_ps(squares, _mm_shuffle_ps(squares, squares, _MM_SHUFFLE(2, 3, 0, 1)));
+                                                      length = _mm_sqrt_ps(_mm_add_ps(length, _mm_shuffle_ps(length, length, _MM_SHUFFLE(1, 0, 3, 2))));
+                                                      // vectors that cancel out keep their tiny length rather than dividing by zero
+                                                      length = _mm_max_ps(length, _mm_set1_ps(1e-6f));
+                                                      __m128 scale = _mm_or_ps(_mm_and_ps(xyz, _mm_div_ps(_mm_set1_ps(1.0f), length)),
+                                                                               _mm_andnot_ps(xyz, _mm_set1_ps(1.0f)));
+                                                      average = _mm_mul_ps(average, scale);
+                                                  }
+                                                  _mm_storeu_ps(target, average);
+#else
+                                                  for (int channel = 0; channel < 4; channel++)
+                                                  {
+                                                      target[channel] = 0.0f;
+                                                  }
+                                                  for (int r = 0; r < rows; r++)
+                                                  {
+                                                      for (int c = 0; c < columns; c++)
+                                                      {
+                                                          const float *pixel = source_rows[r] + size_t(column_index[c]) * 4;
+                                                          float weight = row_weight[r] * column_weight[c];
+                                                          for (int channel = 0; channel < 4; channel++)
+                                                          {
+                                                              target[channel] += pixel[channel] * weight;
+                                                          }
+                                                      }
+                                                  }
+                                                  if (normal_map)
+                                                  {
+                                                      float length = std::sqrt(target[0] * target[0] + target[1] * target[1] + target[2] * target[2]);
+                                                      length = std::max(length, 1e-6f);
+                                                      for (int channel = 0; channel < 3; channel++)
+                                                      {
+                                                          target[channel] /= length;
+                                                      }
+                                                  }
+#endif
+                                              }
+                                          });
+    }
+}
+
+void generate_mips(const unsigned char *pixels, int width, int height, int n_components, bool srgb, bool normal_map,
+                   std::vector<TextureLevel> &levels)
+{
+    levels.clear();
+    TextureLevel level;
+    level.width = width;
+    level.height = height;
+    level.data.assign(pixels, pixels + size_t(width) * height * n_components);
+    levels.push_back(std::move(level));
+    // only xyz can be renormalized, a grayscale bump map would turn into pure black and white and xy alone
+    // isn't unit length
+    normal_map = normal_map && n_components >= 3;
+
+    // the first level is filtered straight from the 8 bit source, decoding only the rows it needs. Every later one
+    // comes from the unrounded float version of the previous, so rounding never accumulates down the chain.
+    FloatImage current;
+    FloatImage next;
+    size_t row_size = size_t(width) * n_components;
+    auto source_row = [&](int y, float *scratch)
+    {
+        to_float(pixels + y * row_size, width, n_components, srgb, normal_map, scratch);
+        return static_cast<const float *>(scratch);
+    };
+    while (levels.back().width > 1 || levels.back().height > 1)
+    {
+        if (levels.size() == 1)
+        {
+            downsample(width, height, source_row, normal_map, next);
+        }
+        else
+        {
+            auto float_row = [&](int y, float *)
+            {
+                return static_cast<const float *>(current.pixels.data() + size_t(y) * current.width * 4);
+            };
+            downsample(current.width, current.height, float_row, normal_map, next);
+        }
+        std::swap(current, next);
+
+        TextureLevel smaller;
+        smaller.width = current.width;
+        smaller.height = current.height;
+        to_bytes(current, n_components, srgb, normal_map, smaller.data);
+        levels.push_back(std::move(smaller));
+    }
+}
@@ -0,0 +1,19 @@
+#ifndef MIP_GENERATOR_H
+#define MIP_GENERATOR_H
+
+#include <vector>
+
+#include "texture_cooker.h"
+
+// Fills levels with the full mip chain of 8 bit pixels with n_components channels, the source itself first.
+// Every level halves the one above with a 2 tap box along even axes and a 1/4, 1/2, 1/4 tent along odd ones, so
+// no row or column is dropped. The first level is filtered row by row straight from the 8 bit source, later ones in
+// float from the unrounded previous level, all spread over the thread pool. With srgb, the color channels are
+// averaged in linear light so bright and dark details don't darken when they blend; alpha and one or two channel
+// images are filtered as they are. With normal_map and at least 3 channels, xyz are unit vectors encoded as 0..255
+// and every filtered vector is renormalized. Height and bump maps with fewer channels, and normal maps storing only
+// xy, are filtered as plain data.
+void generate_mips(const unsigned char *pixels, int width, int height, int n_components, bool srgb, bool normal_map,
+                   std::vector<TextureLevel> &levels);
+
+#endif
@@ -1,175 +1,613 @@
 #include "model.h"
-#include "stb_image.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+#include "gl_extensions.h"
+#include "gl_state.h"
+#include "model_cache.h"
+#include "thread_pool.h"
 
-Model::Model(const char *path)
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+#if defined(__SSE2__) && !defined(ASSIMP_DOUBLE_PRECISION)
+#define MODEL_SIMD_INTERLEAVE 1
+#include <emmintrin.h>
+#endif
+
+struct Model::PendingLoad
+{
+    std::string path;
+    ModelOptions options;
+
+    // set by the background job once data is filled in, guarded by mutex
+    std::mutex mutex;
+    bool data_ready = false;
+
+    // only touched by the background job until data_ready is set, afterwards only by the GL thread
+    ModelData data;
+    // with options.texture_arrays, the decoded textures packed into arrays
+    MaterialArrays arrays;
+    // every array in group and slot order with the handle the materials already hold, uploaded one per budget step
+    std::vector<TextureArrayData *> array_data;
+    std::vector<TextureHandle> array_textures;
+    size_t arrays_uploaded = 0;
+};
+
+namespace
+{
+    // next free Mesh::material_id, shared by all models
+    std::atomic<unsigned int> next_material_id(0);
+
+    // converts Assimp's separate position/normal/uv streams into the interleaved Vertex layout
+    void interleave_vertices(const aiMesh *mesh, Vertex *vertices)
+    {
+        unsigned int n_vertices = mesh->mNumVertices;
+        const aiVector3D *positions = mesh->mVertices;
+        const aiVector3D *normals = mesh->mNormals;
+        const aiVector3D *texture_coords = mesh->mTextureCoords[0];
+        unsigned int i = 0;
+
+#ifdef MODEL_SIMD_INTERLEAVE
+        static_assert(sizeof(aiVector3D) == 3 * sizeof(float) && sizeof(Vertex) == 8 * sizeof(float), "unexpected vertex layouts");
+        if (normals && texture_coords)
+        {
+            // transpose 4 vertices per iteration: 3 loads per stream, two stores per vertex
+            for (; i + 4 <= n_vertices; i += 4)
+            {
+                const float *p = &positions[i].x;
+                const float *n = &normals[i].x;
+                const float *t = &texture_coords[i].x;
+                __m128 p0 = _mm_loadu_ps(p), p1 = _mm_loadu_ps(p + 4), p2 = _mm_loadu_ps(p + 8); // x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+                __m128 n0 = _mm_loadu_ps(n), n1 = _mm_loadu_ps(n + 4), n2 = _mm_loadu_ps(n + 8);
+                __m128 t0 = _mm_loadu_ps(t), t1 = _mm_loadu_ps(t + 4), t2 = _mm_loadu_ps(t + 8); // u0 v0 w0 u1 | v1 w1 u2 v2 | w2 u3 v3 w3
+                float *out = reinterpret_cast<float *>(vertices + i);
+
+                __m128 z0a0 = _mm_shuffle_ps(p0, n0, _MM_SHUFFLE(0, 0, 2, 2));
+                _mm_storeu_ps(out + 0, _mm_shuffle_ps(p0, z0a0, _MM_SHUFFLE(2, 0, 1, 0)));
+                _mm_storeu_ps(out + 4, _mm_shuffle_ps(n0, t0, _MM_SHUFFLE(1, 0, 2, 1)));
+
+                __m128 x1y1 = _mm_shuffle_ps(p0, p1, _MM_SHUFFLE(0, 0, 3, 3));
+                __m128 z1a1 = _mm_shuffle_ps(p1, n0, _MM_SHUFFLE(3, 3, 1, 1));
+                __m128 u1v1 = _mm_shuffle_ps(t0, t1, _MM_SHUFFLE(0, 0, 3, 3));
+                _mm_storeu_ps(out + 8, _mm_shuffle_ps(x1y1, z1a1, _MM_SHUFFLE(2, 0, 2, 0)));
+                _mm_storeu_ps(out + 12, _mm_shuffle_ps(n1, u1v1, _MM_SHUFFLE(2, 0, 1, 0)));
+
+                __m128 z2a2 = _mm_shuffle_ps(p2, n1, _MM_SHUFFLE(2, 2, 0, 0));
+                __m128 b2c2 = _mm_shuffle_ps(n1, n2, _MM_SHUFFLE(0, 0, 3, 3));
+                _mm_storeu_ps(out + 16, _mm_shuffle_ps(p1, z2a2, _MM_SHUFFLE(2, 0, 3, 2)));
+                _mm_storeu_ps(out + 20, _mm_shuffle_ps(b2c2, t1, _MM_SHUFFLE(3, 2, 2, 0)));
+
+                __m128 z3a3 = _mm_shuffle_ps(p2, n2, _MM_SHUFFLE(1, 1, 3, 3));
+                _mm_storeu_ps(out + 24, _mm_shuffle_ps(p2, z3a3, _MM_SHUFFLE(2, 0, 2, 1)));
+                _mm_storeu_ps(out + 28, _mm_shuffle_ps(n2, t2, _MM_SHUFFLE(2, 1, 3, 2)));
+            }
+        }
+#endif
+
+        // remainder, and meshes without normals or texture coordinates
+        for (; i < n_vertices; i++)
+        {
+            Vertex &vertex = vertices[i];
+            vertex.position = glm::vec3(positions[i].x, positions[i].y, positions[i].z);
+            vertex.normal = normals ? glm::vec3(normals[i].x, normals[i].y, normals[i].z) : glm::vec3(0.0f);
+            vertex.texture_coords = texture_coords ? glm::vec2(texture_coords[i].x, texture_coords[i].y) : glm::vec2(0.0f);
+        }
+    }
+}
+
+unsigned int ModelOptions::import_flags() const
+{
+    unsigned int flags = 0;
+    if (optimize_meshes)
+    {
+        flags |= 1u << 0;
+        if (optimize_overdraw)
+        {
+            flags |= 1u << 1;
+        }
+    }
+    if (split_large_meshes)
+    {
+        flags |= 1u << 2;
+    }
+    if (generate_lods)
+    {
+        flags |= 1u << 3;
+    }
+    return flags;
+}
+
+Model::Model(const char *path, bool async, const ModelOptions &options) : options(options)
 {
-    // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
-    stbi_set_flip_vertically_on_load(true);
+    std::string model_path = path;
+    directory = model_path.substr(0, model_path.find_last_of('/'));
 
-    load_model(path);
+    pending = std::make_shared<PendingLoad>();
+    pending->path = model_path;
+    pending->options = options;
+
+    if (async)
+    {
+        // the job keeps its own reference so it can safely finish even if this model goes away first
+        std::shared_ptr<PendingLoad> load = pending;
+        ThreadPool::shared().submit([load]()
+                                    { load_model(load->path, *load); });
+    }
+    else
+    {
+        load_model(model_path, *pending);
+        // textures are still decoded on the thread pool, keep uploading until all of them arrived
+        while (!update(std::numeric_limits<double>::infinity()))
+        {
+            std::this_thread::yield();
+        }
+    }
 }
 
 void Model::draw(Shader &shader)
 {
+    if (mesh_buffer)
+    {
+        draw_batched(shader, nullptr);
+        return;
+    }
+
     for (int i = 0; i < meshes.size(); i++)
     {
         meshes[i].draw(shader);
     }
 }
 
-void Model::load_model(std::string path)
+void Model::draw(Shader &shader, const RenderView &view)
 {
-    Assimp::Importer importer;
-    const aiScene *scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+    if (mesh_buffer)
+    {
+        draw_batched(shader, &view);
+        return;
+    }
 
-    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+    meshes_drawn = 0;
+    meshes_culled = 0;
+    for (int i = 0; i < meshes.size(); i++)
+    {
+        if (!meshes[i].is_visible(view))
+        {
+            meshes_culled++;
+            continue;
+        }
+        meshes[i].draw(shader, meshes[i].select_lod(view));
+        meshes_drawn++;
+    }
+}
+
+void Model::draw_instanced(Shader &shader, const InstanceBuffer &instances)
+{
+    if (instances.size() == 0)
     {
-        std::cout << "ERROR:ASSIMP::" << importer.GetErrorString() << std::endl;
         return;
     }
-    directory = path.substr(0, path.find_last_of('/'));
 
-    process_node(scene->mRootNode, scene);
+    shader.set_bool(uniform_id("instanced"), true);
+    for (Mesh &mesh : meshes)
+    {
+        mesh.draw_instanced(shader, instances);
+    }
+    shader.set_bool(uniform_id("instanced"), false);
 }
 
-void Model::process_node(aiNode *node, const aiScene *scene)
+void Model::draw_batched(Shader &shader, const RenderView *view)
 {
-    for (int i = 0; i < node->mNumMeshes; i++)
+    // gather the draw arguments of every visible mesh per material, meshes with the same material share all textures
+    meshes_drawn = 0;
+    meshes_culled = 0;
+    for (Batch &batch : batches)
     {
-        aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-        meshes.push_back(process_mesh(mesh, scene));
+        batch.counts.clear();
+        batch.offsets.clear();
+        batch.base_vertices.clear();
     }
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        if (view && !meshes[i].is_visible(*view))
+        {
+            meshes_culled++;
+            continue;
+        }
 
-    for (int i = 0; i < node->mNumChildren; i++)
+        Batch &batch = batches[mesh_materials[i]];
+        if (batch.counts.empty())
+        {
+            batch.first_mesh = i;
+        }
+        GLsizei count;
+        void *offset;
+        GLint base_vertex;
+        meshes[i].get_draw_arguments(view ? meshes[i].select_lod(*view) : 0, count, offset, base_vertex);
+        batch.counts.push_back(count);
+        batch.offsets.push_back(offset);
+        batch.base_vertices.push_back(base_vertex);
+        meshes_drawn++;
+    }
+
+    // one VAO for everything and one draw call per material
+    GLState::get().bind_vertex_array(mesh_buffer->get_vao());
+    for (const Batch &batch : batches)
     {
-        process_node(node->mChildren[i], scene);
+        if (batch.counts.empty())
+        {
+            continue;
+        }
+        const Mesh &mesh = meshes[batch.first_mesh];
+        mesh.bind_textures(shader);
+        mesh.set_vertex_uniforms(shader);
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, batch.counts.data(), mesh_buffer->get_index_type(), batch.offsets.data(),
+                                      static_cast<GLsizei>(batch.counts.size()), batch.base_vertices.data());
     }
 }
 
-Mesh Model::process_mesh(aiMesh *mesh, const aiScene *scene)
+bool Model::update(double budget_ms)
 {
-    std::vector<Vertex> vertices;
-    std::vector<unsigned int> indices;
-    std::vector<Texture> textures;
+    if (!pending)
+    {
+        return true;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool uploaded_any = false;
+    auto within_budget = [&]()
+    {
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        return !uploaded_any || elapsed.count() < budget_ms;
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(pending->mutex);
+        if (!pending->data_ready)
+        {
+            return false;
+        }
+    }
+
+    // first update after the import finished, request every texture the meshes use from the registry
+    // which starts decoding the ones no other model has loaded yet
+    ModelData &data = pending->data;
+    if (material_textures.empty() && !data.materials.empty())
+    {
+        material_textures.resize(data.materials.size());
+        batch_materials.resize(data.materials.size());
+        material_layers.assign(data.materials.size(), 0);
+        first_material_id = next_material_id.fetch_add(static_cast<unsigned int>(data.materials.size()));
+        for (unsigned int i = 0; i < data.materials.size(); i++)
+        {
+            batch_materials[i] = i;
+        }
 
-    for (int i = 0; i < mesh->mNumVertices; i++)
-    {
-        Vertex vertex;
-        // position
-        glm::vec3 position;
-        position.x = mesh->mVertices[i].x;
-        position.y = mesh->mVertices[i].y;
-        position.z = mesh->mVertices[i].z;
-        vertex.position = position;
-        // normals
-        glm::vec3 normal;
-        normal.x = mesh->mNormals[i].x;
-        normal.y = mesh->mNormals[i].y;
-        normal.z = mesh->mNormals[i].z;
-        vertex.normal = normal;
-        // texture coordinates
-        if (mesh->mTextureCoords[0])
-        {
-            glm::vec2 texture_coords;
-            texture_coords.x = mesh->mTextureCoords[0][i].x;
-            texture_coords.y = mesh->mTextureCoords[0][i].y;
-            vertex.texture_coords = texture_coords;
+        if (options.texture_arrays)
+        {
+            // already decoded in the background, only the uploads are left
+            assign_material_arrays(*pending);
         }
         else
         {
-            vertex.texture_coords = glm::vec2(0.0f, 0.0f);
+            std::vector<bool> material_used(data.materials.size(), false);
+            for (const MeshData &mesh : data.meshes)
+            {
+                material_used[mesh.material] = true;
+            }
+            for (int i = 0; i < data.materials.size(); i++)
+            {
+                if (material_used[i])
+                {
+                    material_textures[i] = load_material_textures(data.materials[i]);
+                }
+            }
         }
-        vertices.push_back(vertex);
+        meshes.reserve(data.meshes.size());
     }
-    // indices
-    for (int i = 0; i < mesh->mNumFaces; i++)
+
+    // the shared buffer is sized for the whole model before the first mesh goes in
+    if (options.shared_buffers && !mesh_buffer && !data.meshes.empty())
     {
-        aiFace face = mesh->mFaces[i];
-        for (int j = 0; j < face.mNumIndices; j++)
+        size_t vertex_count = 0;
+        size_t index_count = 0;
+        size_t max_mesh_vertices = 0;
+        glm::vec3 min = data.meshes[0].bounds.min;
+        glm::vec3 max = data.meshes[0].bounds.max;
+        for (const MeshData &mesh : data.meshes)
         {
-            indices.push_back(face.mIndices[j]);
+            vertex_count += mesh.vertices.size();
+            index_count += mesh.indices.size();
+            max_mesh_vertices = std::max(max_mesh_vertices, mesh.vertices.size());
+            min = glm::min(min, mesh.bounds.min);
+            max = glm::max(max, mesh.bounds.max);
         }
+        mesh_buffer.reset(new MeshBuffer(vertex_count, index_count, max_mesh_vertices, min, max, options.vertex_format, options.texture_arrays));
+        batches.resize(data.materials.size());
     }
-    // material
-    if (mesh->mMaterialIndex >= 0)
+
+    // textures first, a mesh only becomes drawable once all of its textures are on the GPU
+    while (within_budget() && pending->arrays_uploaded < pending->array_data.size())
     {
-        aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
-        std::vector<Texture> diffuse_maps = load_material_textures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuse_maps.begin(), diffuse_maps.end());
-        std::vector<Texture> specular_maps = load_material_textures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specular_maps.begin(), specular_maps.end());
+        size_t i = pending->arrays_uploaded++;
+        upload_texture_array(*pending->array_data[i], *pending->array_textures[i]);
+        uploaded_any = true;
+    }
+    TextureRegistry &registry = TextureRegistry::instance();
+    while (within_budget() && registry.upload_next())
+    {
+        uploaded_any = true;
     }
-    return Mesh(vertices, indices, textures);
-}
 
-std::vector<Texture> Model::load_material_textures(aiMaterial *material, aiTextureType type, std::string type_name)
-{
-    std::vector<Texture> textures;
-    for (int i = 0; i < material->GetTextureCount(type); i++)
+    while (meshes_uploaded < data.meshes.size() && within_budget())
     {
-        aiString path;
-        material->GetTexture(type, i, &path);
-        bool skip = false;
-        for (int j = 0; j < textures_loaded.size(); j++)
+        MeshData &mesh = data.meshes[meshes_uploaded];
+        if (!textures_resident(material_textures[mesh.material]))
         {
-            textures.push_back(textures_loaded[i]);
-            skip = true;
             break;
         }
-        if (!skip)
+        // the converted arrays are moved all the way into the mesh, never copied
+        if (mesh_buffer)
         {
-            Texture texture;
-            texture.id = load_texture(path.C_Str(), directory);
-            texture.type = type_name;
-            texture.path = path.C_Str();
-            textures.push_back(texture);
-            textures_loaded.push_back(texture);
+            MeshBufferRange range = mesh_buffer->append(mesh.vertices, mesh.indices, material_layers[mesh.material]);
+            meshes.emplace_back(std::move(mesh.vertices), std::move(mesh.indices), material_textures[mesh.material], std::move(mesh.lods),
+                                mesh.bounds, range);
+        }
+        else
+        {
+            meshes.emplace_back(std::move(mesh.vertices), std::move(mesh.indices), material_textures[mesh.material], std::move(mesh.lods),
+                                mesh.bounds, options.vertex_format);
         }
+        meshes.back().material_id = first_material_id + batch_materials[mesh.material];
+        meshes.back().texture_layer = material_layers[mesh.material];
+        mesh_materials.push_back(batch_materials[mesh.material]);
+        mesh = MeshData();
+        meshes_uploaded++;
+        uploaded_any = true;
     }
-    return textures;
+
+    if (meshes_uploaded == data.meshes.size())
+    {
+        pending.reset();
+        return true;
+    }
+    return false;
 }
 
-unsigned int Model::load_texture(char const *path, std::string &directory)
+void Model::load_model(std::string path, PendingLoad &load)
 {
-    std::string filename = directory + '/' + path;
-
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, n_components;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &n_components, 0);
-    if (data)
+    // warm starts read the already-converted meshes from the binary cache and skip Assimp entirely
+    ModelCache cache(path, load.options.import_flags());
+    if (!cache.load(load.data))
     {
-        GLenum format;
-        if (n_components == 1)
+        if (import_model(path, load.options, load.data))
         {
-            format = GL_RED;
+            cache.save(load.data);
         }
-        else if (n_components == 3)
+        else
         {
-            format = GL_RGB;
+            load.data = ModelData();
         }
-        else if (n_components == 4)
+    }
+
+    // decoding here instead of through the registry keeps it off the GL thread, update() only uploads the arrays
+    if (load.options.texture_arrays)
+    {
+        std::vector<bool> material_used(load.data.materials.size(), false);
+        for (const MeshData &mesh : load.data.meshes)
         {
-            format = GL_RGBA;
+            material_used[mesh.material] = true;
         }
+        bool compress = load.options.compress_textures && GLExtensions::get().texture_compression_s3tc;
+        build_material_arrays(load.data.materials, material_used, path.substr(0, path.find_last_of('/')), compress, load.arrays);
+    }
+
+    std::lock_guard<std::mutex> lock(load.mutex);
+    load.data_ready = true;
+}
+
+bool Model::import_model(const std::string &path, const ModelOptions &options, ModelData &data)
+{
+    // OBJ and similar formats come with a separate vertex per face corner, without welding them there is
+    // nothing for the vertex cache to reuse and no connectivity for the simplifier to work with
+    unsigned int flags = aiProcess_Triangulate | aiProcess_FlipUVs;
+    if (options.optimize_meshes || options.generate_lods)
+    {
+        flags |= aiProcess_JoinIdenticalVertices;
+    }
+
+    Assimp::Importer importer;
+    const aiScene *scene = importer.ReadFile(path, flags);
+
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+    {
+        std::cout << "ERROR:ASSIMP::" << importer.GetErrorString() << std::endl;
+        return false;
+    }
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+    data.materials.resize(scene->mNumMaterials);
+    for (int i = 0; i < scene->mNumMaterials; i++)
+    {
+        data.materials[i] = process_material(scene->mMaterials[i]);
+    }
+
+    // meshes are converted independently of each other, so spread them over the thread pool.
+    // Per mesh: convert, split, simplify into levels of detail, then reorder all levels for the GPU.
+    std::vector<aiMesh *> scene_meshes;
+    process_node(scene->mRootNode, scene, scene_meshes);
+    std::vector<std::vector<MeshData>> chunks(scene_meshes.size());
+    std::vector<std::vector<MeshOptimizationReport>> reports(scene_meshes.size());
+    ThreadPool::shared().parallel_for(scene_meshes.size(), [&](size_t i)
+                                      {
+                                          MeshData mesh = process_mesh(scene_meshes[i]);
+                                          if (options.split_large_meshes)
+                                          {
+                                              chunks[i] = split_mesh(mesh);
+                                          }
+                                          else
+                                          {
+                                              chunks[i].push_back(std::move(mesh));
+                                          }
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                                          for (MeshData &chunk : chunks[i])
+                                          {
+                                              if (options.generate_lods)
+                                              {
+                                                  generate_lods(chunk);
+                                              }
+                                              if (options.optimize_meshes)
+                                              {
+                                                  reports[i].push_back(optimize_mesh(chunk, options.optimize_overdraw));
+                                              }
+                                          }
+                                      });
+
+    data.meshes.clear();
+    for (int i = 0; i < chunks.size(); i++)
+    {
+        for (int j = 0; j < chunks[i].size(); j++)
+        {
+            if (options.optimize_meshes && options.report_optimization)
+            {
+                const MeshOptimizationReport &report = reports[i][j];
+                std::cout << "MESH_OPTIMIZER::MESH " << data.meshes.size() << ": ACMR " << report.before.acmr << " -> " << report.after.acmr
+                          << ", ATVR " << report.before.atvr << " -> " << report.after.atvr << std::endl;
+            }
+            data.meshes.push_back(std::move(chunks[i][j]));
+        }
+    }
+    return true;
+}
 
-        stbi_image_free(data);
+void Model::process_node(aiNode *node, const aiScene *scene, std::vector<aiMesh *> &scene_meshes)
+{
+    for (int i = 0; i < node->mNumMeshes; i++)
+    {
+        scene_meshes.push_back(scene->mMeshes[node->mMeshes[i]]);
     }
-    else
+
+    for (int i = 0; i < node->mNumChildren; i++)
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        process_node(node->mChildren[i], scene, scene_meshes);
     }
+}
+
+MeshData Model::process_mesh(aiMesh *mesh)
+{
+    MeshData data;
 
-    return textureID;
+    // vertices, written straight into their final place
+    data.vertices.resize(mesh->mNumVertices);
+    interleave_vertices(mesh, data.vertices.data());
+
+    // indices, counted first so the array is allocated exactly once
+    size_t n_indices = 0;
+    for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+    {
+        n_indices += mesh->mFaces[i].mNumIndices;
+    }
+    data.indices.resize(n_indices);
+
+    unsigned int *index = data.indices.data();
+    for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+    {
+        const aiFace &face = mesh->mFaces[i];
+        std::copy(face.mIndices, face.mIndices + face.mNumIndices, index);
+        index += face.mNumIndices;
+    }
+    // bounds, for culling
+    data.bounds = compute_bounds(data.vertices);
+    // material
+    data.material = mesh->mMaterialIndex;
+    return data;
+}
+
+MaterialData Model::process_material(aiMaterial *material)
+{
+    MaterialData data;
+    get_material_textures(material, aiTextureType_DIFFUSE, "texture_diffuse", data.textures);
+    get_material_textures(material, aiTextureType_SPECULAR, "texture_specular", data.textures);
+    // OBJ's map_Bump, which in practice holds tangent space normals
+    get_material_textures(material, aiTextureType_HEIGHT, "texture_normal", data.textures);
+    return data;
+}
+
+void Model::get_material_textures(aiMaterial *material, aiTextureType type, std::string type_name, std::vector<TextureRef> &textures)
+{
+    for (int i = 0; i < material->GetTextureCount(type); i++)
+    {
+        aiString path;
+        material->GetTexture(type, i, &path);
+        textures.push_back({type_name, path.C_Str()});
+    }
+}
+
+std::vector<Texture> Model::load_material_textures(const MaterialData &material)
+{
+    TextureParams params;
+    params.compress = options.compress_textures;
+    std::vector<Texture> textures;
+    for (const TextureRef &ref : material.textures)
+    {
+        params.normal_map = ref.type == "texture_normal";
+        Texture texture;
+        texture.handle = TextureRegistry::instance().acquire(directory + '/' + ref.path, params);
+        texture.type = ref.type;
+        texture.path = ref.path;
+        textures.push_back(texture);
+    }
+    return textures;
+}
+
+void Model::assign_material_arrays(PendingLoad &load)
+{
+    // every slot of a group becomes one array, bound for all of the group's materials under the first one's id.
+    // The handles stay non resident until update() uploaded them, which holds back the meshes like registry textures
+    MaterialArrays &arrays = load.arrays;
+    std::vector<std::vector<Texture>> group_textures(arrays.groups.size());
+    std::vector<int> group_material(arrays.groups.size(), -1);
+    for (size_t group = 0; group < arrays.groups.size(); group++)
+    {
+        for (TextureArrayData &slot : arrays.groups[group])
+        {
+            Texture texture;
+            texture.handle = std::make_shared<TextureResource>();
+            texture.type = slot.type;
+            group_textures[group].push_back(texture);
+            load.array_data.push_back(&slot);
+            load.array_textures.push_back(texture.handle);
+        }
+    }
+
+    // materials without a group had no textures or failed to load, they are drawn without textures
+    for (unsigned int i = 0; i < arrays.material_group.size(); i++)
+    {
+        int group = arrays.material_group[i];
+        if (group < 0)
+        {
+            continue;
+        }
+        if (group_material[group] < 0)
+        {
+            group_material[group] = static_cast<int>(i);
+        }
+        material_textures[i] = group_textures[group];
+        batch_materials[i] = static_cast<unsigned int>(group_material[group]);
+        material_layers[i] = arrays.material_layer[i];
+    }
+}
+
+bool Model::textures_resident(const std::vector<Texture> &textures)
+{
+    for (const Texture &texture : textures)
+    {
+        if (!texture.handle->resident)
+        {
+            return false;
+        }
+    }
+    return true;
 }
@@ -1,6 +1,7 @@
 #ifndef MODEL_H
 #define MODEL_H
 
+#include <memory>
 #include <vector>
 
 #include <assimp/Importer.hpp>
@@ -9,25 +10,110 @@
 #include <assimp/scene.h>
 
 #include "mesh.h"
+#include "mesh_buffer.h"
+#include "model_data.h"
+#include "render_view.h"
 #include "shader.h"
+#include "texture_array.h"
+
+// load options, everything that changes the imported data is part of the mesh cache key (see import_flags)
+struct ModelOptions
+{
+    // reorder triangles for the post-transform vertex cache and vertices for fetch locality
+    bool optimize_meshes = true;
+    // additionally sort triangle clusters to reduce overdraw, only used with optimize_meshes
+    bool optimize_overdraw = false;
+    // print the vertex cache statistics of every mesh optimize_meshes imports, only affects logging and not the cached data
+    bool report_optimization = false;
+    // split meshes with more than 65536 vertices so every mesh can be drawn with 16 bit indices
+    bool split_large_meshes = false;
+    // build a chain of simplified levels of detail per mesh, picked by screen space error in draw(shader, view)
+    bool generate_lods = true;
+    // GPU vertex layout, only affects the upload and not the cached data
+    Vertex_Format vertex_format = FLOAT_VERTICES;
+    // upload all meshes into one shared MeshBuffer and draw them with one multi-draw per material,
+    // only affects the upload and not the cached data
+    bool shared_buffers = false;
+    // pack the textures of materials with matching texture lists into texture arrays, so meshes that only differ in
+    // their textures share a material. Together with shared_buffers they also share a VAO and get drawn with one
+    // multi-draw, by draw_batched() and by RenderQueue alike. Needs a shader built with TEXTURE_ARRAYS, only affects
+    // the upload and not the cached data.
+    bool texture_arrays = false;
+    // upload textures block compressed with precomputed mip chains, cooked once into "<image>.<flags>.texcache" files
+    // (see TextureCache). Needs S3TC, only affects the upload and not the cached data.
+    bool compress_textures = false;
+
+    unsigned int import_flags() const;
+};
 
 class Model
 {
 public:
-    Model(const char *path);
+    // loads the model before returning. With async set, returns right away and does the import and texture decoding
+    // on the thread pool instead; call update() once per frame to upload whatever finished in the background.
+    Model(const char *path, bool async = false, const ModelOptions &options = ModelOptions());
+    // draws the full detail meshes
     void draw(Shader &shader);
+    // draws the meshes that intersect the view frustum, each at the coarsest level of detail whose error
+    // stays below view.lod_threshold pixels
+    void draw(Shader &shader, const RenderView &view);
+    // draws the full detail meshes once per transform in instances with one instanced draw call per mesh,
+    // the "model" uniform is ignored for these draws
+    void draw_instanced(Shader &shader, const InstanceBuffer &instances);
+
+    // meshes drawn and skipped by frustum culling in the last draw(shader, view)
+    unsigned int meshes_drawn = 0;
+    unsigned int meshes_culled = 0;
+
+    // uploads finished meshes and textures for roughly budget_ms milliseconds (at least one item per call),
+    // must be called on the thread owning the GL context. Returns true once the model is fully loaded.
+    bool update(double budget_ms);
+    bool is_loaded() const { return !pending; }
+
+    // the meshes uploaded so far
+    std::vector<Mesh> &get_meshes() { return meshes; }
 
 private:
     // model data
     std::vector<Mesh> meshes;
-    std::vector<Texture> textures_loaded;
+    std::vector<unsigned int> mesh_materials;
+    std::vector<std::vector<Texture>> material_textures;
+    // per material, the material whose id and batch it uses and its texture array layer. Materials packed into the
+    // same arrays all use the group's first material, without texture arrays every material uses its own.
+    std::vector<unsigned int> batch_materials;
+    std::vector<unsigned int> material_layers;
+    // material_id of the model's first material, ids are handed out in blocks per model
+    unsigned int first_material_id = 0;
     std::string directory;
+    ModelOptions options;
+
+    // state shared with the background load, released once everything is uploaded
+    struct PendingLoad;
+    std::shared_ptr<PendingLoad> pending;
+    size_t meshes_uploaded = 0;
+
+    // with options.shared_buffers, the buffer holding every mesh and the per material draw lists rebuilt by every draw
+    struct Batch
+    {
+        size_t first_mesh;
+        std::vector<GLsizei> counts;
+        std::vector<void *> offsets;
+        std::vector<GLint> base_vertices;
+    };
+    std::unique_ptr<MeshBuffer> mesh_buffer;
+    std::vector<Batch> batches;
+
+    void draw_batched(Shader &shader, const RenderView *view);
 
-    void load_model(std::string path);
-    void process_node(aiNode *node, const aiScene *scene);
-    Mesh process_mesh(aiMesh *mesh, const aiScene *scene);
-    std::vector<Texture> load_material_textures(aiMaterial *material, aiTextureType type, std::string type_name);
-    unsigned int load_texture(char const *path, std::string &directory);
+    static void load_model(std::string path, PendingLoad &load);
+    static bool import_model(const std::string &path, const ModelOptions &options, ModelData &data);
+    static void process_node(aiNode *node, const aiScene *scene, std::vector<aiMesh *> &scene_meshes);
+    static MeshData process_mesh(aiMesh *mesh);
+    static MaterialData process_material(aiMaterial *material);
+    static void get_material_textures(aiMaterial *material, aiTextureType type, std::string type_name, std::vector<TextureRef> &textures);
+    std::vector<Texture> load_material_textures(const MaterialData &material);
+    void assign_material_arrays(PendingLoad &load);
+    static bool textures_resident(const std::vector<Texture> &textures);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,375 @@
+#include "model_cache.h"
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#include "mapped_file.h"
+#include "temporary_path.h"
+
+namespace
+{
+    // bump whenever the layout below or the import pipeline that produces the cached data changes
+    const uint32_t cache_version = 5;
+    const char cache_magic[8] = {'L', 'O', 'G', 'L', 'M', 'E', 'S', 'H'};
+
+    // file layout: header | meshes | lods | materials | textures | strings | vertices | indices
+    struct CacheHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t vertex_size;
+        uint32_t import_flags;
+        uint32_t padding;
+        uint64_t source_size;
+        int64_t source_mtime;
+        uint32_t mesh_count;
+        uint32_t lod_count;
+        uint32_t material_count;
+        uint32_t texture_count;
+        uint32_t string_size;
+        uint32_t padding2;
+        uint64_t vertex_offset;
+        uint64_t vertex_count;
+        uint64_t index_offset;
+        uint64_t index_count;
+    };
+
+    struct CacheMesh
+    {
+        uint64_t first_vertex;
+        uint64_t first_index;
+        uint32_t vertex_count;
+        uint32_t index_count;
+        uint32_t material;
+        uint32_t first_lod;
+        uint32_t lod_count;
+        uint32_t padding;
+        float bounds_min[3];
+        float bounds_max[3];
+        float bounds_center[3];
+        float bounds_radius;
+    };
+
+    // index range relative to the mesh's first index
+    struct CacheLod
+    {
+        uint32_t first_index;
+        uint32_t index_count;
+        float error;
+    };
+
+    struct CacheMaterial
+    {
+        uint32_t first_texture;
+        uint32_t texture_count;
+    };
+
+    struct CacheTexture
+    {
+        uint32_t type_offset;
+        uint32_t type_length;
+        uint32_t path_offset;
+        uint32_t path_length;
+    };
+
+    // vertex data is aligned so it can be read in place from the mapping
+    const uint64_t data_alignment = 16;
+
+    uint64_t align_up(uint64_t value)
+    {
+        return (value + data_alignment - 1) & ~(data_alignment - 1);
+    }
+
+    template <typename T>
+    void read_table(const unsigned char *bytes, uint64_t offset, std::vector<T> &table, size_t count)
+    {
+        table.resize(count);
+        if (count > 0)
+        {
+            std::memcpy(table.data(), bytes + offset, count * sizeof(T));
+        }
+    }
+
+    template <typename T>
+    void write_table(std::ofstream &file, const std::vector<T> &table)
+    {
+        if (!table.empty())
+        {
+            file.write(reinterpret_cast<const char *>(table.data()), table.size() * sizeof(T));
+        }
+    }
+}
+
+ModelCache::ModelCache(const std::string &source_path, unsigned int import_flags)
+    : source_path(source_path), cache_path(source_path + ".meshcache"), import_flags(import_flags)
+{
+}
+
+bool ModelCache::source_stamp(unsigned long long &size, long long &mtime) const
+{
+    std::error_code error;
+    size = std::filesystem::file_size(source_path, error);
+    if (error)
+    {
+        return false;
+    }
+    std::filesystem::file_time_type time = std::filesystem::last_write_time(source_path, error);
+    if (error)
+    {
+        return false;
+    }
+    mtime = static_cast<long long>(time.time_since_epoch().count());
+    return true;
+}
+
+bool ModelCache::load(ModelData &data) const
+{
+    unsigned long long source_size;
+    long long source_mtime;
+    if (!source_stamp(source_size, source_mtime))
+    {
+        return false;
+    }
+
+    MappedFile file;
+    if (!file.open(cache_path) || file.size() < sizeof(CacheHeader))
+    {
+        return false;
+    }
+    const unsigned char *bytes = file.data();
+
+    CacheHeader header;
+    std::memcpy(&header, bytes, sizeof(header));
+    if (std::memcmp(header.magic, cache_magic, sizeof(cache_magic)) != 0 || header.version != cache_version ||
+        header.vertex_size != sizeof(Vertex) || header.import_flags != import_flags || header.source_size != source_size || header.source_mtime != source_mtime)
+    {
+        return false;
+    }
+
+    // validate every range against the file size before touching it
+    if (header.vertex_count > file.size() || header.index_count > file.size())
+    {
+        std::cout << "ERROR::MODEL_CACHE::MALFORMED_FILE: " << cache_path << std::endl;
+        return false;
+    }
+    uint64_t mesh_offset = sizeof(CacheHeader);
+    uint64_t lod_offset = mesh_offset + uint64_t(header.mesh_count) * sizeof(CacheMesh);
+    uint64_t material_offset = lod_offset + uint64_t(header.lod_count) * sizeof(CacheLod);
+    uint64_t texture_offset = material_offset + uint64_t(header.material_count) * sizeof(CacheMaterial);
+    uint64_t string_offset = texture_offset + uint64_t(header.texture_count) * sizeof(CacheTexture);
+    uint64_t string_end = string_offset + header.string_size;
+    uint64_t vertex_end = header.vertex_offset + header.vertex_count * sizeof(Vertex);
+    uint64_t index_end = header.index_offset + header.index_count * sizeof(unsigned int);
+    if (string_end > header.vertex_offset || header.vertex_offset % data_alignment != 0 || vertex_end > header.index_offset ||
+        index_end > file.size())
+    {
+        std::cout << "ERROR::MODEL_CACHE::MALFORMED_FILE: " << cache_path << std::endl;
+        return false;
+    }
+
+    std::vector<CacheMesh> meshes;
+    std::vector<CacheLod> lods;
+    std::vector<CacheMaterial> materials;
+    std::vector<CacheTexture> textures;
+    read_table(bytes, mesh_offset, meshes, header.mesh_count);
+    read_table(bytes, lod_offset, lods, header.lod_count);
+    read_table(bytes, material_offset, materials, header.material_count);
+    read_table(bytes, texture_offset, textures, header.texture_count);
+    const char *strings = reinterpret_cast<const char *>(bytes + string_offset);
+
+    data.materials.clear();
+    data.materials.reserve(materials.size());
+    for (const CacheMaterial &cached : materials)
+    {
+        if (uint64_t(cached.first_texture) + cached.texture_count > textures.size())
+        {
+            std::cout << "ERROR::MODEL_CACHE::MALFORMED_FILE: " << cache_path << std::endl;
+            return false;
+        }
+
+        MaterialData material;
+        for (uint32_t i = 0; i < cached.texture_count; i++)
+        {
+            const CacheTexture &texture = textures[cached.first_texture + i];
+            if (uint64_t(texture.type_offset) + texture.type_length > header.string_size ||
+                uint64_t(texture.path_offset) + texture.path_length > header.string_size)
+            {
+                std::cout << "ERROR::MODEL_CACHE::MALFORMED_FILE: " << cache_path << std::endl;
+                return false;
+            }
+            material.textures.push_back({std::string(strings + texture.type_offset, texture.type_length),
+                                         std::string(strings + texture.path_offset, texture.path_length)});
+        }
+        data.materials.push_back(std::move(material));
+    }
+
+    const Vertex *vertices = reinterpret_cast<const Vertex *>(bytes + header.vertex_offset);
+    const unsigned int *indices = reinterpret_cast<const unsigned int *>(bytes + header.index_offset);
+
+    data.meshes.clear();
+    data.meshes.resize(meshes.size());
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        const CacheMesh &cached = meshes[i];
+        if (cached.first_vertex + cached.vertex_count > header.vertex_count || cached.first_index + cached.index_count > header.index_count ||
+            cached.material >= data.materials.size() || uint64_t(cached.first_lod) + cached.lod_count > lods.size())
+        {
+            std::cout << "ERROR::MODEL_CACHE::MALFORMED_FILE: " << cache_path << std::endl;
+            data.meshes.clear();
+            return false;
+        }
+
+        MeshData &mesh = data.meshes[i];
+        mesh.vertices.assign(vertices + cached.first_vertex, vertices + cached.first_vertex + cached.vertex_count);
+        mesh.indices.assign(indices + cached.first_index, indices + cached.first_index + cached.index_count);
+        mesh.material = cached.material;
+        mesh.bounds.min = glm::vec3(cached.bounds_min[0], cached.bounds_min[1], cached.bounds_min[2]);
+        mesh.bounds.max = glm::vec3(cached.bounds_max[0], cached.bounds_max[1], cached.bounds_max[2]);
+        mesh.bounds.center = glm::vec3(cached.bounds_center[0], cached.bounds_center[1], cached.bounds_center[2]);
+        mesh.bounds.radius = cached.bounds_radius;
+
+        for (uint32_t j = 0; j < cached.lod_count; j++)
+        {
+            const CacheLod &lod = lods[cached.first_lod + j];
+            if (uint64_t(lod.first_index) + lod.index_count > cached.index_count)
+            {
+                std::cout << "ERROR::MODEL_CACHE::MALFORMED_FILE: " << cache_path << std::endl;
+                data.meshes.clear();
+                return false;
+            }
+            mesh.lods.push_back({lod.first_index, lod.index_count, lod.error});
+        }
+    }
+
+    return true;
+}
+
+bool ModelCache::save(const ModelData &data) const
+{
+    CacheHeader header = {};
+    std::memcpy(header.magic, cache_magic, sizeof(cache_magic));
+    header.version = cache_version;
+    header.vertex_size = sizeof(Vertex);
+    header.import_flags = import_flags;
+    unsigned long long source_size;
+    long long source_mtime;
+    if (!source_stamp(source_size, source_mtime))
+    {
+        return false;
+    }
+    header.source_size = source_size;
+    header.source_mtime = source_mtime;
+
+    std::vector<CacheMesh> meshes;
+    std::vector<CacheLod> lods;
+    std::vector<CacheMaterial> materials;
+    std::vector<CacheTexture> textures;
+    std::string strings;
+
+    for (const MaterialData &material : data.materials)
+    {
+        materials.push_back({uint32_t(textures.size()), uint32_t(material.textures.size())});
+        for (const TextureRef &texture : material.textures)
+        {
+            CacheTexture cached;
+            cached.type_offset = uint32_t(strings.size());
+            cached.type_length = uint32_t(texture.type.size());
+            strings += texture.type;
+            cached.path_offset = uint32_t(strings.size());
+            cached.path_length = uint32_t(texture.path.size());
+            strings += texture.path;
+            textures.push_back(cached);
+        }
+    }
+
+    for (const MeshData &mesh : data.meshes)
+    {
+        CacheMesh cached = {};
+        cached.first_vertex = header.vertex_count;
+        cached.first_index = header.index_count;
+        cached.vertex_count = uint32_t(mesh.vertices.size());
+        cached.index_count = uint32_t(mesh.indices.size());
+        cached.material = mesh.material;
+        cached.first_lod = uint32_t(lods.size());
+        cached.lod_count = uint32_t(mesh.lods.size());
+        for (int j = 0; j < 3; j++)
+        {
+            cached.bounds_min[j] = mesh.bounds.min[j];
+            cached.bounds_max[j] = mesh.bounds.max[j];
+            cached.bounds_center[j] = mesh.bounds.center[j];
+        }
+        cached.bounds_radius = mesh.bounds.radius;
+        meshes.push_back(cached);
+
+        for (const MeshLod &lod : mesh.lods)
+        {
+            lods.push_back({lod.first_index, lod.index_count, lod.error});
+        }
+
+        header.vertex_count += mesh.vertices.size();
+        header.index_count += mesh.indices.size();
+    }
+
+    header.mesh_count = uint32_t(meshes.size());
+    header.lod_count = uint32_t(lods.size());
+    header.material_count = uint32_t(materials.size());
+    header.texture_count = uint32_t(textures.size());
+    header.string_size = uint32_t(strings.size());
+
+    uint64_t string_offset = sizeof(CacheHeader) + meshes.size() * sizeof(CacheMesh) + lods.size() * sizeof(CacheLod) +
+                             materials.size() * sizeof(CacheMaterial) + textures.size() * sizeof(CacheTexture);
+    header.vertex_offset = align_up(string_offset + strings.size());
+    header.index_offset = header.vertex_offset + header.vertex_count * sizeof(Vertex);
+
+    // write to a temporary file first so a crash never leaves a truncated cache behind. Two asynchronous loads of
+    // the same model import on the thread pool at once, so the name is unique to this writer
+    std::string temp_path = temporary_path(cache_path);
+    std::error_code error;
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            std::cout << "ERROR::MODEL_CACHE::FILE_NOT_WRITABLE: " << cache_path << std::endl;
+            return false;
+        }
+
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        write_table(file, meshes);
+        write_table(file, lods);
+        write_table(file, materials);
+        write_table(file, textures);
+        file.write(strings.data(), strings.size());
+
+        std::vector<char> padding(header.vertex_offset - (string_offset + strings.size()), 0);
+        file.write(padding.data(), padding.size());
+
+        for (const MeshData &mesh : data.meshes)
+        {
+            write_table(file, mesh.vertices);
+        }
+        for (const MeshData &mesh : data.meshes)
+        {
+            write_table(file, mesh.indices);
+        }
+
+        if (!file)
+        {
+            std::cout << "ERROR::MODEL_CACHE::FILE_NOT_WRITABLE: " << cache_path << std::endl;
+            file.close();
+            std::filesystem::remove(temp_path, error);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(temp_path, cache_path, error);
+    if (error)
+    {
+        std::cout << "ERROR::MODEL_CACHE::FILE_NOT_WRITABLE: " << cache_path << std::endl;
+        std::filesystem::remove(temp_path, error);
+        return false;
+    }
+    return true;
+}
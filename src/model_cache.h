@@ -0,0 +1,31 @@
+#ifndef MODEL_CACHE_H
+#define MODEL_CACHE_H
+
+#include <string>
+
+#include "model_data.h"
+
+// Versioned binary cache of an imported model, stored next to the source asset as "<asset>.meshcache".
+// The file holds the already-converted vertex and index arrays together with the mesh and material tables,
+// so a warm start is a single mmap instead of an Assimp import. The cache is ignored and rewritten whenever
+// the format version, the Vertex layout, the import flags or the source asset's size/modification time change.
+class ModelCache
+{
+public:
+    // import_flags identifies the import options the cached data was produced with
+    ModelCache(const std::string &source_path, unsigned int import_flags);
+
+    // fills data from the cache file, returns false if it is missing, stale or malformed
+    bool load(ModelData &data) const;
+    // writes data to the cache file, returns false if the file could not be written
+    bool save(const ModelData &data) const;
+
+private:
+    std::string source_path;
+    std::string cache_path;
+    unsigned int import_flags;
+
+    bool source_stamp(unsigned long long &size, long long &mtime) const;
+};
+
+#endif
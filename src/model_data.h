@@ -0,0 +1,40 @@
+#ifndef MODEL_DATA_H
+#define MODEL_DATA_H
+
+#include <string>
+#include <vector>
+
+#include "mesh.h"
+
+// CPU-side representation of an imported model, independent of Assimp and of any GL objects.
+// This is what gets written to and read back from the binary model cache.
+
+// a texture referenced by a material, path is relative to the model's directory
+struct TextureRef
+{
+    std::string type;
+    std::string path;
+};
+
+struct MaterialData
+{
+    std::vector<TextureRef> textures;
+};
+
+struct MeshData
+{
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    // levels of detail in indices, empty if the whole index array is the only level
+    std::vector<MeshLod> lods;
+    MeshBounds bounds;
+    unsigned int material = 0;
+};
+
+struct ModelData
+{
+    std::vector<MeshData> meshes;
+    std::vector<MaterialData> materials;
+};
+
+#endif
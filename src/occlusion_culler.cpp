@@ -0,0 +1,256 @@
+#include "occlusion_culler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "thread_pool.h"
+
+#if defined(__SSE2__)
+#define OCCLUSION_SIMD 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // rows per band, bands are the unit of work handed to the thread pool
+    const unsigned int band_height = 16;
+    // vertices closer than this to the eye plane are not projected, triangles using them are dropped
+    const float near_w = 1e-3f;
+}
+
+OcclusionCuller::OcclusionCuller(unsigned int width, unsigned int height)
+    : width((width + 3) & ~3u), height(height), depth(this->width * height, 0.0f), view_projection(1.0f)
+{
+}
+
+void OcclusionCuller::begin(const glm::mat4 &view_projection)
+{
+    this->view_projection = view_projection;
+    std::fill(depth.begin(), depth.end(), 0.0f);
+    occluders.clear();
+}
+
+void OcclusionCuller::add_occluder(const Mesh &mesh, const unsigned int *indices, size_t index_count, const glm::mat4 &model)
+{
+    occluders.push_back({&mesh, indices, index_count, view_projection * model});
+}
+
+void OcclusionCuller::rasterize()
+{
+    ThreadPool &pool = ThreadPool::shared();
+
+    triangles.resize(occluders.size());
+    pool.parallel_for(occluders.size(), [&](size_t i)
+                      { setup_triangles(occluders[i], triangles[i]); });
+
+    // every band walks all triangles and only touches its own rows, so no two threads write the same pixel
+    unsigned int band_count = (height + band_height - 1) / band_height;
+    pool.parallel_for(band_count, [&](size_t band)
+                      {
+                          unsigned int first_row = static_cast<unsigned int>(band) * band_height;
+                          rasterize_band(first_row, std::min(first_row + band_height, height));
+                      });
+}
+
+void OcclusionCuller::setup_triangles(const Occluder &occluder, std::vector<Triangle> &result) const
+{
+    result.clear();
+
+    // project every vertex once, w <= near_w marks the ones that can't be projected
+    const std::vector<Vertex> &vertices = occluder.mesh->vertices;
+    std::vector<glm::vec3> screen(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        glm::vec4 clip = occluder.model_view_projection * glm::vec4(vertices[i].position, 1.0f);
+        if (clip.w <= near_w)
+        {
+            screen[i] = glm::vec3(0.0f, 0.0f, -1.0f);
+            continue;
+        }
+        float inverse_w = 1.0f / clip.w;
+        screen[i] = glm::vec3((clip.x * inverse_w * 0.5f + 0.5f) * width, (clip.y * inverse_w * 0.5f + 0.5f) * height, inverse_w);
+    }
+
+    for (size_t i = 0; i + 2 < occluder.index_count; i += 3)
+    {
+        const glm::vec3 &a = screen[occluder.indices[i]];
+        const glm::vec3 &b = screen[occluder.indices[i + 1]];
+        const glm::vec3 &c = screen[occluder.indices[i + 2]];
+        // dropping a triangle that crosses the near plane only makes the culling more conservative
+        if (a.z <= 0.0f || b.z <= 0.0f || c.z <= 0.0f)
+        {
+            continue;
+        }
+
+        // both faces are rasterized, so counter-clockwise winding is made the rule here
+        float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+        if (std::abs(area) < 1e-6f)
+        {
+            continue;
+        }
+        const glm::vec3 &second = area > 0.0f ? b : c;
+        const glm::vec3 &third = area > 0.0f ? c : b;
+
+        Triangle triangle;
+        triangle.position[0] = glm::vec2(a);
+        triangle.position[1] = glm::vec2(second);
+        triangle.position[2] = glm::vec2(third);
+        triangle.inverse_w[0] = a.z;
+        triangle.inverse_w[1] = second.z;
+        triangle.inverse_w[2] = third.z;
+        triangle.min_x = std::max(static_cast<int>(std::floor(std::min({a.x, b.x, c.x}))), 0);
+        triangle.max_x = std::min(static_cast<int>(std::ceil(std::max({a.x, b.x, c.x}))) - 1, static_cast<int>(width) - 1);
+        triangle.min_y = std::max(static_cast<int>(std::floor(std::min({a.y, b.y, c.y}))), 0);
+        triangle.max_y = std::min(static_cast<int>(std::ceil(std::max({a.y, b.y, c.y}))) - 1, static_cast<int>(height) - 1);
+        if (triangle.min_x <= triangle.max_x && triangle.min_y <= triangle.max_y)
+        {
+            result.push_back(triangle);
+        }
+    }
+}
+
+void OcclusionCuller::rasterize_band(unsigned int first_row, unsigned int end_row)
+{
+    for (const std::vector<Triangle> &occluder_triangles : triangles)
+    {
+        for (const Triangle &triangle : occluder_triangles)
+        {
+            if (triangle.max_y >= static_cast<int>(first_row) && triangle.min_y < static_cast<int>(end_row))
+            {
+                rasterize_triangle(triangle, first_row, end_row);
+            }
+        }
+    }
+}
+
+void OcclusionCuller::rasterize_triangle(const Triangle &triangle, unsigned int first_row, unsigned int end_row)
+{
+    const glm::vec2 *p = triangle.position;
+    const float *z = triangle.inverse_w;
+
+    // edge functions e = a * x + b * y + c, positive inside, evaluated at pixel centers
+    float edge_a[3], edge_b[3], edge_c[3];
+    for (int i = 0; i < 3; i++)
+    {
+        const glm::vec2 &from = p[i];
+        const glm::vec2 &to = p[(i + 1) % 3];
+        edge_a[i] = from.y - to.y;
+        edge_b[i] = to.x - from.x;
+        edge_c[i] = -(edge_a[i] * from.x + edge_b[i] * from.y);
+    }
+
+    // 1 / w is linear in screen space. Going half a pixel against the gradient gives the farthest depth within the pixel.
+    float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[1].y - p[0].y) * (p[2].x - p[0].x);
+    float z_dx = ((z[1] - z[0]) * (p[2].y - p[0].y) - (z[2] - z[0]) * (p[1].y - p[0].y)) / area;
+    float z_dy = ((z[2] - z[0]) * (p[1].x - p[0].x) - (z[1] - z[0]) * (p[2].x - p[0].x)) / area;
+    float z_c = z[0] - z_dx * p[0].x - z_dy * p[0].y - 0.5f * (std::abs(z_dx) + std::abs(z_dy));
+
+    int min_y = std::max(triangle.min_y, static_cast<int>(first_row));
+    int max_y = std::min(triangle.max_y, static_cast<int>(end_row) - 1);
+    int min_x = triangle.min_x & ~3;
+    for (int y = min_y; y <= max_y; y++)
+    {
+        float center_y = y + 0.5f;
+        float *row = depth.data() + size_t(y) * width;
+        float row_e[3];
+        for (int i = 0; i < 3; i++)
+        {
+            row_e[i] = edge_b[i] * center_y + edge_c[i];
+        }
+        float row_z = z_dy * center_y + z_c;
+
+#ifdef OCCLUSION_SIMD
+        const __m128 lane = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+        __m128 a0 = _mm_set1_ps(edge_a[0]), a1 = _mm_set1_ps(edge_a[1]), a2 = _mm_set1_ps(edge_a[2]);
+        __m128 e0_row = _mm_set1_ps(row_e[0]), e1_row = _mm_set1_ps(row_e[1]), e2_row = _mm_set1_ps(row_e[2]);
+        __m128 z_dx4 = _mm_set1_ps(z_dx), z_row = _mm_set1_ps(row_z);
+        __m128 zero = _mm_setzero_ps();
+        for (int x = min_x; x <= triangle.max_x; x += 4)
+        {
+            __m128 center_x = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), lane);
+            __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, center_x), e0_row);
+            __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, center_x), e1_row);
+            __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, center_x), e2_row);
+            __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+            if (_mm_movemask_ps(inside) == 0)
+            {
+                continue;
+            }
+
+            __m128 pixel_z = _mm_add_ps(_mm_mul_ps(z_dx4, center_x), z_row);
+            __m128 current = _mm_loadu_ps(row + x);
+            __m128 closer = _mm_max_ps(current, pixel_z);
+            _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, closer), _mm_andnot_ps(inside, current)));
+        }
+#else
+        for (int x = min_x; x <= triangle.max_x; x++)
+        {
+            float center_x = x + 0.5f;
+            if (edge_a[0] * center_x + row_e[0] >= 0.0f && edge_a[1] * center_x + row_e[1] >= 0.0f && edge_a[2] * center_x + row_e[2] >= 0.0f)
+            {
+                row[x] = std::max(row[x], z_dx * center_x + row_z);
+            }
+        }
+#endif
+    }
+}
+
+bool OcclusionCuller::is_visible(const glm::vec3 &min, const glm::vec3 &max) const
+{
+    // screen rectangle and closest depth of the box's corners
+    glm::vec2 screen_min(std::numeric_limits<float>::max());
+    glm::vec2 screen_max(-std::numeric_limits<float>::max());
+    float closest = 0.0f;
+    for (int i = 0; i < 8; i++)
+    {
+        glm::vec3 corner(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z);
+        glm::vec4 clip = view_projection * glm::vec4(corner, 1.0f);
+        if (clip.w <= near_w)
+        {
+            // reaches behind the eye, which can't be projected, so treat it as visible
+            return true;
+        }
+        float inverse_w = 1.0f / clip.w;
+        glm::vec2 screen((clip.x * inverse_w * 0.5f + 0.5f) * width, (clip.y * inverse_w * 0.5f + 0.5f) * height);
+        screen_min = glm::min(screen_min, screen);
+        screen_max = glm::max(screen_max, screen);
+        closest = std::max(closest, inverse_w);
+    }
+
+    int min_x = std::max(static_cast<int>(std::floor(screen_min.x)), 0);
+    int max_x = std::min(static_cast<int>(std::ceil(screen_max.x)) - 1, static_cast<int>(width) - 1);
+    int min_y = std::max(static_cast<int>(std::floor(screen_min.y)), 0);
+    int max_y = std::min(static_cast<int>(std::ceil(screen_max.y)) - 1, static_cast<int>(height) - 1);
+    if (min_x > max_x || min_y > max_y)
+    {
+        // off screen, that is for frustum culling to decide
+        return true;
+    }
+
+    // visible as soon as a single pixel of the rectangle is farther away than the box
+    for (int y = min_y; y <= max_y; y++)
+    {
+        const float *row = depth.data() + size_t(y) * width;
+#ifdef OCCLUSION_SIMD
+        // the rectangle is widened to whole groups of 4, which can only err towards visible
+        __m128 box_depth = _mm_set1_ps(closest);
+        for (int x = min_x & ~3; x <= max_x; x += 4)
+        {
+            if (_mm_movemask_ps(_mm_cmple_ps(_mm_loadu_ps(row + x), box_depth)) != 0)
+            {
+                return true;
+            }
+        }
+#else
+        for (int x = min_x; x <= max_x; x++)
+        {
+            if (row[x] <= closest)
+            {
+                return true;
+            }
+        }
+#endif
+    }
+    return false;
+}
@@ -0,0 +1,64 @@
+#ifndef OCCLUSION_CULLER_H
+#define OCCLUSION_CULLER_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "mesh.h"
+
+// Software occlusion culling against a small CPU depth buffer. A handful of designated occluders (large, simple,
+// solid meshes such as walls and floors) are rasterized every frame, then the screen space bounds of every other
+// mesh are tested against the result before it is drawn. The buffer holds 1 / w per pixel, 0 being infinitely far,
+// and is split into bands of rows that are rasterized in parallel on the thread pool, 4 pixels at a time with SSE2.
+// Occluder coverage is sampled at pixel centers, the depth written is the farthest the triangle gets within the pixel,
+// and tested boxes cover every pixel they touch. The only way to cull something visible is a sliver of less than
+// one buffer pixel along an occluder's silhouette.
+class OcclusionCuller
+{
+public:
+    // width is rounded up to a multiple of 4
+    OcclusionCuller(unsigned int width = 256, unsigned int height = 128);
+
+    // clears the buffer and forgets the occluders of the last frame
+    void begin(const glm::mat4 &view_projection);
+    // queues the triangles indices[0, index_count) of mesh as an occluder, they have to stay alive until rasterize()
+    void add_occluder(const Mesh &mesh, const unsigned int *indices, size_t index_count, const glm::mat4 &model);
+    // rasterizes the queued occluders
+    void rasterize();
+
+    // false if the world space box is hidden behind the occluders
+    bool is_visible(const glm::vec3 &min, const glm::vec3 &max) const;
+
+    bool has_occluders() const { return !occluders.empty(); }
+
+private:
+    struct Occluder
+    {
+        const Mesh *mesh;
+        const unsigned int *indices;
+        size_t index_count;
+        glm::mat4 model_view_projection;
+    };
+
+    // screen space triangle ready for rasterizing
+    struct Triangle
+    {
+        glm::vec2 position[3];
+        float inverse_w[3];
+        int min_x, max_x, min_y, max_y;
+    };
+
+    unsigned int width;
+    unsigned int height;
+    std::vector<float> depth;
+    glm::mat4 view_projection;
+    std::vector<Occluder> occluders;
+    std::vector<std::vector<Triangle>> triangles;
+
+    void setup_triangles(const Occluder &occluder, std::vector<Triangle> &result) const;
+    void rasterize_band(unsigned int first_row, unsigned int end_row);
+    void rasterize_triangle(const Triangle &triangle, unsigned int first_row, unsigned int end_row);
+};
+
+#endif
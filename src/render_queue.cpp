@@ -0,0 +1,192 @@
+#include "render_queue.h"
+
+#include <cstring>
+
+#include "gl_state.h"
+
+namespace
+{
+    const UniformId MODEL = uniform_id("model");
+
+    // key layout, most significant first
+    const int pass_bits = 2;
+    const int shader_bits = 10;
+    const int material_bits = 16;
+    const int vao_bits = 12;
+    const int depth_bits = 24;
+    static_assert(pass_bits + shader_bits + material_bits + vao_bits + depth_bits == 64, "sort key must fill 64 bits");
+
+    std::uint64_t field(std::uint64_t value, int bits) { return value & ((std::uint64_t(1) << bits) - 1); }
+
+    // the bit pattern of a non-negative float sorts like the float, the top bits keep the exponent and most of the mantissa
+    std::uint64_t depth_field(float distance)
+    {
+        distance = distance > 0.0f ? distance : 0.0f;
+        std::uint32_t bits;
+        std::memcpy(&bits, &distance, sizeof(bits));
+        return bits >> (32 - depth_bits);
+    }
+}
+
+void RenderQueue::clear()
+{
+    items.clear();
+    entries.clear();
+}
+
+void RenderQueue::add(Render_Pass pass, Shader &shader, const Mesh &mesh, unsigned int lod, const glm::mat4 &transform, float distance)
+{
+    Item item;
+    item.shader = &shader;
+    item.mesh = &mesh;
+    item.transform = &transform;
+    mesh.get_draw_arguments(lod, item.count, item.offset, item.base_vertex);
+
+    // fields are truncated to their width, that only affects how well draws group, submit() compares the full values
+    std::uint64_t depth = depth_field(distance);
+    if (pass == TRANSPARENT_PASS)
+    {
+        depth = field(~depth, depth_bits);
+    }
+    std::uint64_t key = field(pass, pass_bits);
+    key = (key << shader_bits) | field(shader.program_id, shader_bits);
+    key = (key << material_bits) | field(mesh.material_id, material_bits);
+    key = (key << vao_bits) | field(mesh.get_vao(), vao_bits);
+    key = (key << depth_bits) | depth;
+
+    entries.push_back({key, static_cast<unsigned int>(items.size())});
+    items.push_back(item);
+}
+
+void RenderQueue::sort()
+{
+    // least significant digit radix sort, 8 bits per pass, all histograms gathered in one sweep
+    size_t counts[8][256] = {};
+    for (const SortEntry &entry : entries)
+    {
+        for (int digit = 0; digit < 8; digit++)
+        {
+            counts[digit][(entry.key >> (digit * 8)) & 0xff]++;
+        }
+    }
+
+    scratch.resize(entries.size());
+    for (int digit = 0; digit < 8; digit++)
+    {
+        // a digit that is the same for every key doesn't reorder anything, which is common for pass and shader
+        size_t *count = counts[digit];
+        if (count[(entries.empty() ? 0 : entries[0].key >> (digit * 8)) & 0xff] == entries.size())
+        {
+            continue;
+        }
+
+        size_t offset = 0;
+        for (int bucket = 0; bucket < 256; bucket++)
+        {
+            size_t n = count[bucket];
+            count[bucket] = offset;
+            offset += n;
+        }
+        for (const SortEntry &entry : entries)
+        {
+            scratch[count[(entry.key >> (digit * 8)) & 0xff]++] = entry;
+        }
+        entries.swap(scratch);
+    }
+}
+
+void RenderQueue::submit()
+{
+    shader_changes = 0;
+    material_changes = 0;
+    vao_changes = 0;
+    redundant_changes = 0;
+    draw_calls = 0;
+
+    Shader *shader = nullptr;
+    const glm::mat4 *transform = nullptr;
+    unsigned int material = 0;
+    unsigned int vao = 0;
+    for (const SortEntry &entry : entries)
+    {
+        const Item &item = items[entry.item];
+        const Mesh &mesh = *item.mesh;
+
+        // a new program has none of the per draw state set yet
+        bool new_shader = item.shader != shader;
+        bool same_run = !new_shader && item.transform == transform && mesh.material_id == material && mesh.get_vao() == vao;
+        if (!same_run)
+        {
+            flush_run();
+        }
+        if (new_shader)
+        {
+            shader = item.shader;
+            shader->use();
+            shader_changes++;
+        }
+        else
+        {
+            redundant_changes++;
+        }
+
+        if (new_shader || item.transform != transform)
+        {
+            transform = item.transform;
+            shader->set_mat4(MODEL, *transform);
+        }
+
+        if (new_shader || mesh.material_id != material)
+        {
+            material = mesh.material_id;
+            mesh.bind_textures(*shader);
+            material_changes++;
+        }
+        else
+        {
+            redundant_changes++;
+        }
+
+        // meshes sharing a VAO share their buffers and with them the vertex quantization
+        if (new_shader || mesh.get_vao() != vao)
+        {
+            vao = mesh.get_vao();
+            GLState::get().bind_vertex_array(vao);
+            mesh.set_vertex_uniforms(*shader);
+            vao_changes++;
+        }
+        else
+        {
+            redundant_changes++;
+        }
+
+        run_counts.push_back(item.count);
+        run_offsets.push_back(item.offset);
+        run_base_vertices.push_back(item.base_vertex);
+        run_index_type = mesh.get_index_type();
+    }
+    flush_run();
+}
+
+void RenderQueue::flush_run()
+{
+    if (run_counts.empty())
+    {
+        return;
+    }
+
+    if (run_counts.size() == 1)
+    {
+        glDrawElementsBaseVertex(GL_TRIANGLES, run_counts[0], run_index_type, run_offsets[0], run_base_vertices[0]);
+    }
+    else
+    {
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, run_counts.data(), run_index_type, run_offsets.data(),
+                                      static_cast<GLsizei>(run_counts.size()), run_base_vertices.data());
+    }
+    draw_calls++;
+
+    run_counts.clear();
+    run_offsets.clear();
+    run_base_vertices.clear();
+}
@@ -0,0 +1,79 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "mesh.h"
+#include "shader.h"
+
+// passes are submitted in this order, opaque draws front to back and transparent ones back to front
+enum Render_Pass
+{
+    OPAQUE_PASS,
+    TRANSPARENT_PASS
+};
+
+// Draws gathered from any number of models for one frame. Every draw gets a 64 bit key
+// (pass | shader | material | VAO | depth, most significant first), the queue is radix sorted on the keys
+// and submitted in that order, so state only changes where the key changes and the submission
+// cost follows the number of distinct states instead of the number of models.
+class RenderQueue
+{
+public:
+    // empties the queue, keeps the memory
+    void clear();
+
+    // queues a level of a mesh, distance is from the camera in world units. Shader and transform are referenced
+    // and must stay alive until submit().
+    void add(Render_Pass pass, Shader &shader, const Mesh &mesh, unsigned int lod, const glm::mat4 &transform, float distance);
+
+    void sort();
+
+    // draws everything in sorted order. Camera state comes from the Frame uniform block (see FrameUniforms),
+    // the queue sets "model", textures and vertex uniforms when they change. Consecutive draws that share shader,
+    // material, VAO and transform, like the meshes of a model in a shared MeshBuffer, go out as one multi-draw.
+    void submit();
+
+    size_t size() const { return items.size(); }
+
+    // state changes made and skipped in the last submit()
+    unsigned int shader_changes = 0;
+    unsigned int material_changes = 0;
+    unsigned int vao_changes = 0;
+    unsigned int redundant_changes = 0;
+    // draw calls issued in the last submit(), a multi-draw counts once
+    unsigned int draw_calls = 0;
+
+private:
+    struct Item
+    {
+        Shader *shader;
+        const Mesh *mesh;
+        const glm::mat4 *transform;
+        GLsizei count;
+        void *offset;
+        GLint base_vertex;
+    };
+    struct SortEntry
+    {
+        std::uint64_t key;
+        unsigned int item;
+    };
+
+    std::vector<Item> items;
+    std::vector<SortEntry> entries;
+    std::vector<SortEntry> scratch;
+
+    // the draw arguments of the run being gathered by submit()
+    std::vector<GLsizei> run_counts;
+    std::vector<void *> run_offsets;
+    std::vector<GLint> run_base_vertices;
+    GLenum run_index_type = GL_UNSIGNED_INT;
+
+    void flush_run();
+};
+
+#endif
@@ -0,0 +1,16 @@
+#include "render_view.h"
+
+#include <algorithm>
+#include <cmath>
+
+RenderView::RenderView(const Camera &camera, const glm::mat4 &projection, const glm::mat4 &view, const glm::mat4 &model, float viewport_height)
+    : camera_position(camera.position), model(model), frustum(projection * view), object_frustum(frustum.transformed(model))
+{
+    projection_scale = viewport_height / (2.0f * std::tan(glm::radians(camera.zoom) * 0.5f));
+}
+
+float RenderView::model_scale() const
+{
+    return std::sqrt(std::max({glm::dot(glm::vec3(model[0]), glm::vec3(model[0])), glm::dot(glm::vec3(model[1]), glm::vec3(model[1])),
+                               glm::dot(glm::vec3(model[2]), glm::vec3(model[2]))}));
+}
@@ -0,0 +1,28 @@
+#ifndef RENDER_VIEW_H
+#define RENDER_VIEW_H
+
+#include <glm/glm.hpp>
+
+#include "camera.h"
+#include "frustum.h"
+
+// Per-draw view information that decisions like culling and level of detail selection are based on.
+struct RenderView
+{
+    glm::vec3 camera_position;
+    glm::mat4 model;
+    // view volume in world space and in the object space of model
+    Frustum frustum;
+    Frustum object_frustum;
+    // pixels covered by one world unit at distance one: viewport height / (2 tan(fov / 2))
+    float projection_scale;
+    // largest screen space error in pixels a coarser level of detail may introduce
+    float lod_threshold = 1.0f;
+
+    RenderView(const Camera &camera, const glm::mat4 &projection, const glm::mat4 &view, const glm::mat4 &model, float viewport_height);
+
+    // largest scale factor of the model matrix, converts object space distances to world space conservatively
+    float model_scale() const;
+};
+
+#endif
@@ -0,0 +1,266 @@
+#include "scene.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "render_view.h"
+
+namespace
+{
+    // Moeller-Trumbore, hits from either side count. Lowers distance and returns true on a hit closer than distance.
+    bool ray_triangle(const glm::vec3 &origin, const glm::vec3 &direction, const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c, float &distance)
+    {
+        glm::vec3 ab = b - a;
+        glm::vec3 ac = c - a;
+        glm::vec3 p = glm::cross(direction, ac);
+        float determinant = glm::dot(ab, p);
+        if (std::abs(determinant) < 1e-12f)
+        {
+            return false;
+        }
+
+        float inverse = 1.0f / determinant;
+        glm::vec3 s = origin - a;
+        float u = glm::dot(s, p) * inverse;
+        glm::vec3 q = glm::cross(s, ab);
+        float v = glm::dot(direction, q) * inverse;
+        float t = glm::dot(ac, q) * inverse;
+        if (u < 0.0f || v < 0.0f || u + v > 1.0f || t < 0.0f || t >= distance)
+        {
+            return false;
+        }
+        distance = t;
+        return true;
+    }
+}
+
+unsigned int Scene::add(Model &model, const glm::mat4 &transform)
+{
+    Instance instance;
+    instance.model = &model;
+    instance.transform = transform;
+    instance.inverse_transform = glm::inverse(transform);
+    instance.first_item = 0;
+    instance.mesh_count = 0;
+    instance.occluder = false;
+    instances.push_back(std::move(instance));
+    needs_rebuild = true;
+    return static_cast<unsigned int>(instances.size() - 1);
+}
+
+void Scene::set_transform(unsigned int instance, const glm::mat4 &transform)
+{
+    Instance &changed = instances[instance];
+    changed.transform = transform;
+    changed.inverse_transform = glm::inverse(transform);
+    if (needs_rebuild)
+    {
+        return;
+    }
+
+    // moving an instance only changes the boxes of its own meshes, the tree is refit in update()
+    std::vector<Mesh> &meshes = changed.model->get_meshes();
+    for (unsigned int i = 0; i < changed.mesh_count; i++)
+    {
+        bvh.update(changed.first_item + i, world_box(changed, meshes[i]));
+    }
+}
+
+void Scene::set_occluder(unsigned int instance, bool occluder)
+{
+    instances[instance].occluder = occluder;
+    has_occluders = false;
+    for (const Instance &other : instances)
+    {
+        has_occluders = has_occluders || other.occluder;
+    }
+}
+
+void Scene::update()
+{
+    for (const Instance &instance : instances)
+    {
+        needs_rebuild = needs_rebuild || instance.model->get_meshes().size() != instance.mesh_count;
+    }
+
+    if (needs_rebuild)
+    {
+        needs_rebuild = false;
+        items.clear();
+        std::vector<BoundingBox> boxes;
+        for (unsigned int i = 0; i < instances.size(); i++)
+        {
+            Instance &instance = instances[i];
+            std::vector<Mesh> &meshes = instance.model->get_meshes();
+            instance.first_item = static_cast<unsigned int>(items.size());
+            instance.mesh_count = static_cast<unsigned int>(meshes.size());
+            instance.triangles.resize(meshes.size());
+            for (unsigned int j = 0; j < meshes.size(); j++)
+            {
+                items.push_back({i, j});
+                boxes.push_back(world_box(instance, meshes[j]));
+            }
+        }
+        bvh.build(std::move(boxes));
+    }
+    else
+    {
+        bvh.refit();
+    }
+}
+
+void Scene::draw(Shader &shader, const Camera &camera, const glm::mat4 &projection, const glm::mat4 &view, float viewport_height)
+{
+    visible.clear();
+    bvh.query_frustum(Frustum(projection * view), visible);
+
+    // items are numbered instance by instance, sorting groups the draws per instance and its model matrix
+    std::sort(visible.begin(), visible.end());
+
+    // occluders in the frustum go into the software depth buffer at full detail, coarser levels may bulge outwards
+    bool occlusion = false;
+    if (has_occluders)
+    {
+        occlusion_culler.begin(projection * view);
+        for (unsigned int index : visible)
+        {
+            const SceneItem &item = items[index];
+            const Instance &instance = instances[item.instance];
+            if (instance.occluder)
+            {
+                const Mesh &mesh = instance.model->get_meshes()[item.mesh];
+                occlusion_culler.add_occluder(mesh, mesh.indices.data() + mesh.lods[0].first_index, mesh.lods[0].index_count, instance.transform);
+            }
+        }
+        occlusion = occlusion_culler.has_occluders();
+        if (occlusion)
+        {
+            occlusion_culler.rasterize();
+        }
+    }
+
+    std::vector<RenderView> views;
+    unsigned int current = ~0u;
+    queue.clear();
+    meshes_drawn = 0;
+    meshes_occluded = 0;
+    for (unsigned int index : visible)
+    {
+        const SceneItem &item = items[index];
+        Instance &instance = instances[item.instance];
+        if (occlusion && !instance.occluder)
+        {
+            const BoundingBox &box = bvh.get_box(index);
+            if (!occlusion_culler.is_visible(box.min, box.max))
+            {
+                meshes_occluded++;
+                continue;
+            }
+        }
+        if (item.instance != current)
+        {
+            current = item.instance;
+            views.emplace_back(camera, projection, view, instance.transform, viewport_height);
+        }
+        const Mesh &mesh = instance.model->get_meshes()[item.mesh];
+        glm::vec3 center = glm::vec3(instance.transform * glm::vec4(mesh.bounds.center, 1.0f));
+        queue.add(OPAQUE_PASS, shader, mesh, mesh.select_lod(views.back()), instance.transform, glm::length(center - camera.position));
+        meshes_drawn++;
+    }
+
+    queue.sort();
+    queue.submit();
+
+    meshes_culled = static_cast<unsigned int>(items.size() - visible.size());
+}
+
+void Scene::query_frustum(const Frustum &frustum, std::vector<SceneItem> &result) const
+{
+    std::vector<unsigned int> found;
+    bvh.query_frustum(frustum, found);
+    for (unsigned int index : found)
+    {
+        result.push_back(items[index]);
+    }
+}
+
+void Scene::query_sphere(const glm::vec3 &center, float radius, std::vector<SceneItem> &result) const
+{
+    std::vector<unsigned int> found;
+    bvh.query_sphere(center, radius, found);
+    for (unsigned int index : found)
+    {
+        result.push_back(items[index]);
+    }
+}
+
+bool Scene::raycast(const glm::vec3 &origin, const glm::vec3 &direction, SceneHit &hit, float max_distance)
+{
+    float length = glm::length(direction);
+    if (length <= 0.0f)
+    {
+        return false;
+    }
+    glm::vec3 world_direction = direction / length;
+
+    float distance = max_distance;
+    unsigned int hit_index;
+    unsigned int hit_triangle = 0;
+    bool found = bvh.raycast(origin, world_direction, distance, hit_index, [&](unsigned int index, float &closest)
+                             { return raycast_mesh(items[index], origin, world_direction, closest, hit_triangle); });
+    if (!found)
+    {
+        return false;
+    }
+
+    hit.item = items[hit_index];
+    hit.triangle = hit_triangle;
+    hit.distance = distance;
+    hit.position = origin + world_direction * distance;
+    return true;
+}
+
+bool Scene::raycast_mesh(const SceneItem &item, const glm::vec3 &origin, const glm::vec3 &direction, float &distance, unsigned int &triangle)
+{
+    Instance &instance = instances[item.instance];
+    const Mesh &mesh = instance.model->get_meshes()[item.mesh];
+    const Bvh &triangles = triangle_bvh(instance, item.mesh);
+    const unsigned int *indices = mesh.indices.data() + mesh.lods[0].first_index;
+
+    // in object space with the direction left unnormalized, distances stay in world units
+    glm::vec3 local_origin = glm::vec3(instance.inverse_transform * glm::vec4(origin, 1.0f));
+    glm::vec3 local_direction = glm::vec3(instance.inverse_transform * glm::vec4(direction, 0.0f));
+    return triangles.raycast(local_origin, local_direction, distance, triangle, [&](unsigned int t, float &closest)
+                             {
+                                 return ray_triangle(local_origin, local_direction, mesh.vertices[indices[t * 3]].position,
+                                                     mesh.vertices[indices[t * 3 + 1]].position, mesh.vertices[indices[t * 3 + 2]].position, closest);
+                             });
+}
+
+BoundingBox Scene::world_box(const Instance &instance, const Mesh &mesh) const
+{
+    return transform_box({mesh.bounds.min, mesh.bounds.max}, instance.transform);
+}
+
+const Bvh &Scene::triangle_bvh(Instance &instance, unsigned int mesh_index)
+{
+    std::unique_ptr<Bvh> &triangles = instance.triangles[mesh_index];
+    if (!triangles)
+    {
+        // full detail triangles in object space, so moving the instance never invalidates them
+        const Mesh &mesh = instance.model->get_meshes()[mesh_index];
+        const MeshLod &lod = mesh.lods[0];
+        std::vector<BoundingBox> boxes(lod.index_count / 3);
+        for (size_t t = 0; t < boxes.size(); t++)
+        {
+            const unsigned int *corner = mesh.indices.data() + lod.first_index + t * 3;
+            const glm::vec3 &a = mesh.vertices[corner[0]].position;
+            const glm::vec3 &b = mesh.vertices[corner[1]].position;
+            const glm::vec3 &c = mesh.vertices[corner[2]].position;
+            boxes[t] = {glm::min(glm::min(a, b), c), glm::max(glm::max(a, b), c)};
+        }
+        triangles.reset(new Bvh());
+        triangles->build(std::move(boxes));
+    }
+    return *triangles;
+}
@@ -0,0 +1,90 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "bvh.h"
+#include "camera.h"
+#include "model.h"
+#include "occlusion_culler.h"
+#include "render_queue.h"
+#include "shader.h"
+
+// a mesh of an instance
+struct SceneItem
+{
+    unsigned int instance;
+    unsigned int mesh;
+};
+
+struct SceneHit
+{
+    SceneItem item;
+    unsigned int triangle;
+    float distance;
+    glm::vec3 position;
+};
+
+// Placed model instances with a BVH over the world space bounds of all of their meshes, so culling and picking
+// scale with what is visible or hit instead of with the size of the scene. Models are referenced, not owned,
+// and may still be loading, update() picks up their meshes as they arrive.
+class Scene
+{
+public:
+    // returns the instance index
+    unsigned int add(Model &model, const glm::mat4 &transform = glm::mat4(1.0f));
+    void set_transform(unsigned int instance, const glm::mat4 &transform);
+    const glm::mat4 &get_transform(unsigned int instance) const { return instances[instance].transform; }
+    // the meshes of occluder instances are drawn as usual and additionally hide whatever is behind them from the
+    // occlusion culler. Best suited for large, simple and closed geometry like walls, floors and terrain.
+    void set_occluder(unsigned int instance, bool occluder);
+
+    // rebuilds the hierarchy when meshes were added and refits it when transforms changed, call before drawing or querying
+    void update();
+
+    // draws every mesh in the view frustum that isn't hidden behind an occluder, at the level of detail chosen for the camera.
+    // The draws go through a RenderQueue sorted by shader, material and buffers, so state changes are shared across instances.
+    void draw(Shader &shader, const Camera &camera, const glm::mat4 &projection, const glm::mat4 &view, float viewport_height);
+
+    void query_frustum(const Frustum &frustum, std::vector<SceneItem> &items) const;
+    void query_sphere(const glm::vec3 &center, float radius, std::vector<SceneItem> &items) const;
+    // closest triangle hit by the ray within max_distance, in world space. Triangle hierarchies are built on first use.
+    bool raycast(const glm::vec3 &origin, const glm::vec3 &direction, SceneHit &hit, float max_distance = 1e30f);
+
+    // meshes drawn, outside the frustum and hidden behind occluders in the last draw()
+    unsigned int meshes_drawn = 0;
+    unsigned int meshes_culled = 0;
+    unsigned int meshes_occluded = 0;
+
+private:
+    struct Instance
+    {
+        Model *model;
+        glm::mat4 transform;
+        glm::mat4 inverse_transform;
+        // index of the instance's first mesh in items, and how many of its meshes were loaded at the last rebuild
+        unsigned int first_item;
+        unsigned int mesh_count;
+        bool occluder;
+        // per mesh triangle hierarchies for raycast, empty until needed
+        std::vector<std::unique_ptr<Bvh>> triangles;
+    };
+
+    std::vector<Instance> instances;
+    std::vector<SceneItem> items;
+    Bvh bvh;
+    bool needs_rebuild = false;
+    std::vector<unsigned int> visible;
+    OcclusionCuller occlusion_culler;
+    bool has_occluders = false;
+    RenderQueue queue;
+
+    BoundingBox world_box(const Instance &instance, const Mesh &mesh) const;
+    bool raycast_mesh(const SceneItem &item, const glm::vec3 &origin, const glm::vec3 &direction, float &distance, unsigned int &triangle);
+    const Bvh &triangle_bvh(Instance &instance, unsigned int mesh);
+};
+
+#endif
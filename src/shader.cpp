@@ -1,112 +1,338 @@
 #include "shader.h"
+#include "gl_extensions.h"
+#include "gl_state.h"
+#include "shader_cache.h"
+#include <algorithm>
 #include <filesystem>
 
-Shader::Shader(const char *vertex_shader_path, const char *fragment_shader_path)
+Shader::Shader(const char *vertex_shader_path, const char *fragment_shader_path, bool deferred)
 {
-    std::string vertex_shader_src;
-    std::string fragment_shader_src;
-    std::ifstream vertex_shader_file;
-    std::ifstream fragment_shader_file;
-    vertex_shader_file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    fragment_shader_file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+    std::filesystem::path cwd = std::filesystem::current_path();
+    std::cout << "Current working directory: " << cwd << std::endl;
 
-    // try reading the shader files
-    try
-    {
-        std::filesystem::path cwd = std::filesystem::current_path();
-        std::cout << "Current working directory: " << cwd << std::endl;
-
-        vertex_shader_file.open(vertex_shader_path);
-        fragment_shader_file.open(fragment_shader_path);
+    // read the shader files, with their includes spliced in
+    ShaderSource source;
+    read_source(vertex_shader_path, fragment_shader_path, "", source);
+    build(source, deferred);
+}
 
-        std::stringstream vertex_shader_stream;
-        std::stringstream fragment_shader_stream;
+Shader::Shader(const ShaderSource &source, bool deferred)
+{
+    build(source, deferred);
+}
 
-        vertex_shader_stream << vertex_shader_file.rdbuf();
-        fragment_shader_stream << fragment_shader_file.rdbuf();
+void Shader::build(const ShaderSource &source, bool deferred)
+{
+    vertex_path = source.vertex_path;
+    fragment_path = source.fragment_path;
+    defines = source.defines;
+    files = source.files;
 
-        vertex_shader_file.close();
-        fragment_shader_file.close();
+    start_build(source, current);
+    pending = true;
 
-        vertex_shader_src = vertex_shader_stream.str();
-        fragment_shader_src = fragment_shader_stream.str();
-    }
-    catch (std::ifstream::failure e)
+    if (!deferred)
     {
-        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
+        finish();
     }
+}
 
-    const char *vertex_shader_code = vertex_shader_src.c_str();
-    const char *fragment_shader_code = fragment_shader_src.c_str();
+bool Shader::read_source(const std::string &vertex_path, const std::string &fragment_path, const std::string &defines, ShaderSource &source)
+{
+    source.vertex_path = vertex_path;
+    source.fragment_path = fragment_path;
+    source.defines = defines;
+    source.files.clear();
+    bool success = resolve_includes(vertex_path, source.vertex, source.files);
+    success = resolve_includes(fragment_path, source.fragment, source.files) && success;
+    source.vertex = inject_defines(source.vertex, defines);
+    source.fragment = inject_defines(source.fragment, defines);
+    return success;
+}
 
-    unsigned int vertex_shader;
-    unsigned int fragment_shader;
+void Shader::start_build(const ShaderSource &source, Build &build)
+{
+    // a program linked on an earlier run with the same sources and driver skips compiling entirely
+    build.cache.reset(new ShaderCache(source.vertex, source.fragment, source.defines));
+    build.program = build.cache->load();
+    if (build.program != 0)
+    {
+        return;
+    }
+
+    const char *vertex_shader_code = source.vertex.c_str();
+    const char *fragment_shader_code = source.fragment.c_str();
 
+    // nothing here queries a status, so the driver is free to compile and link in the background
     // compile vertex shader
-    vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex_shader, 1, &vertex_shader_code, NULL);
-    glCompileShader(vertex_shader);
-    check_compile_errors(vertex_shader, "VERTEX");
+    build.vertex_shader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(build.vertex_shader, 1, &vertex_shader_code, NULL);
+    glCompileShader(build.vertex_shader);
 
     // compile fragment shader
-    fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment_shader, 1, &fragment_shader_code, NULL);
-    glCompileShader(fragment_shader);
-    check_compile_errors(fragment_shader, "FRAGMENT");
+    build.fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(build.fragment_shader, 1, &fragment_shader_code, NULL);
+    glCompileShader(build.fragment_shader);
 
     // attach and link the shaders to a program
-    program_id = glCreateProgram();
-    glAttachShader(program_id, vertex_shader);
-    glAttachShader(program_id, fragment_shader);
-    glLinkProgram(program_id);
-    check_compile_errors(program_id, "PROGRAM");
+    build.program = glCreateProgram();
+    ShaderCache::prepare(build.program);
+    glAttachShader(build.program, build.vertex_shader);
+    glAttachShader(build.program, build.fragment_shader);
+    glLinkProgram(build.program);
+}
+
+bool Shader::build_done(const Build &build) const
+{
+    // without the extension there is no way to ask without waiting, so it counts as done
+    int done = GL_TRUE;
+    if (GLExtensions::get().parallel_shader_compile)
+    {
+        glGetProgramiv(build.program, GL_COMPLETION_STATUS_KHR, &done);
+    }
+    return done != GL_FALSE;
+}
+
+bool Shader::finish_build(Build &build)
+{
+    // programs restored from the cache have no shaders, they are linked already
+    bool success = true;
+    if (build.vertex_shader != 0)
+    {
+        check_compile_errors(build.vertex_shader, "VERTEX");
+        check_compile_errors(build.fragment_shader, "FRAGMENT");
+        success = check_compile_errors(build.program, "PROGRAM");
+        if (success)
+        {
+            build.cache->save(build.program);
+        }
+
+        // cleanup since the shaders are already linked at this point
+        glDeleteShader(build.vertex_shader);
+        glDeleteShader(build.fragment_shader);
+        build.vertex_shader = 0;
+        build.fragment_shader = 0;
+    }
+    build.cache.reset();
+    return success;
+}
+
+void Shader::discard_build(Build &build)
+{
+    glDeleteShader(build.vertex_shader);
+    glDeleteShader(build.fragment_shader);
+    GLState::get().deleted_program(build.program);
+    glDeleteProgram(build.program);
+    build = Build();
+}
+
+bool Shader::is_ready()
+{
+    if (!pending)
+    {
+        return true;
+    }
+    if (!build_done(current))
+    {
+        return false;
+    }
+    finish();
+    return true;
+}
+
+void Shader::finish()
+{
+    if (!pending)
+    {
+        return;
+    }
+    pending = false;
+
+    finish_build(current);
+    program_id = current.program;
+    load_uniform_locations();
+    bind_uniform_blocks();
+}
+
+bool Shader::reload()
+{
+    if (vertex_path.empty())
+    {
+        return false;
+    }
+
+    ShaderSource source;
+    if (!read_source(vertex_path, fragment_path, defines, source))
+    {
+        std::cout << "ERROR::SHADER::RELOAD_FAILED: keeping the previous program" << std::endl;
+        return false;
+    }
+    files = source.files;
+
+    // a newer edit supersedes a rebuild that is still running
+    if (reloading)
+    {
+        discard_build(next);
+    }
+    start_build(source, next);
+    reloading = true;
+    return true;
+}
+
+bool Shader::apply_reload()
+{
+    if (!reloading || pending || !build_done(next))
+    {
+        return false;
+    }
+    reloading = false;
+
+    if (!finish_build(next))
+    {
+        std::cout << "ERROR::SHADER::RELOAD_FAILED: keeping the previous program" << std::endl;
+        discard_build(next);
+        return false;
+    }
 
-    // cleanup since the shaders are already linked at this point
-    glDeleteShader(vertex_shader);
-    glDeleteShader(fragment_shader);
+    GLState::get().deleted_program(current.program);
+    glDeleteProgram(current.program);
+    current = std::move(next);
+    next = Build();
+    program_id = current.program;
+    load_uniform_locations();
+    bind_uniform_blocks();
+    return true;
 }
 
 Shader::~Shader()
 {
-    glDeleteProgram(program_id);
+    discard_build(current);
+    discard_build(next);
 }
 
 void Shader::use()
 {
-    glUseProgram(program_id);
+    if (pending)
+    {
+        finish();
+    }
+    GLState::get().use_program(program_id);
 }
 
 void Shader::set_bool(const std::string &name, bool value) const
 {
-    int location = glGetUniformLocation(program_id, name.c_str());
-    glUniform1i(location, (int)value);
+    set_bool(uniform_id(name.c_str()), value);
 }
 
 void Shader::set_int(const std::string &name, int value) const
 {
-    int location = glGetUniformLocation(program_id, name.c_str());
-    glUniform1i(location, value);
+    set_int(uniform_id(name.c_str()), value);
 }
 
 void Shader::set_float(const std::string &name, float value) const
 {
-    int location = glGetUniformLocation(program_id, name.c_str());
-    glUniform1f(location, value);
+    set_float(uniform_id(name.c_str()), value);
 }
 
-void Shader::set_mat4(const std::string &name, glm::mat4 &value) const
+void Shader::set_mat4(const std::string &name, const glm::mat4 &value) const
 {
-    unsigned int location = glGetUniformLocation(program_id, name.c_str());
-    glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+    set_mat4(uniform_id(name.c_str()), value);
 }
 
 void Shader::set_vec3(const std::string &name, glm::vec3 value) const
 {
-    unsigned int location = glGetUniformLocation(program_id, name.c_str());
-    glUniform3f(location, value[0], value[1], value[2]);
+    set_vec3(uniform_id(name.c_str()), value);
+}
+
+void Shader::set_bool(UniformId id, bool value) const
+{
+    glUniform1i(get_uniform_location(id), (int)value);
+}
+
+void Shader::set_int(UniformId id, int value) const
+{
+    glUniform1i(get_uniform_location(id), value);
+}
+
+void Shader::set_float(UniformId id, float value) const
+{
+    glUniform1f(get_uniform_location(id), value);
+}
+
+void Shader::set_mat4(UniformId id, const glm::mat4 &value) const
+{
+    glUniformMatrix4fv(get_uniform_location(id), 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void Shader::set_vec3(UniformId id, glm::vec3 value) const
+{
+    glUniform3f(get_uniform_location(id), value[0], value[1], value[2]);
+}
+
+int Shader::get_uniform_location(UniformId id) const
+{
+    auto found = std::lower_bound(uniform_locations.begin(), uniform_locations.end(), std::make_pair(id, -1));
+    return found != uniform_locations.end() && found->first == id ? found->second : -1;
+}
+
+void Shader::load_uniform_locations()
+{
+    uniform_locations.clear();
+    int uniform_count = 0;
+    int max_length = 0;
+    glGetProgramiv(program_id, GL_ACTIVE_UNIFORMS, &uniform_count);
+    glGetProgramiv(program_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+
+    std::vector<char> name(std::max(max_length, 1));
+    for (int i = 0; i < uniform_count; i++)
+    {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type;
+        glGetActiveUniform(program_id, i, static_cast<GLsizei>(name.size()), &length, &size, &type, name.data());
+        std::string uniform_name(name.data(), length);
+        int location = glGetUniformLocation(program_id, uniform_name.c_str());
+        if (location < 0)
+        {
+            // members of uniform blocks have no location
+            continue;
+        }
+        uniform_locations.push_back({uniform_id(uniform_name.c_str()), location});
+
+        // arrays are reported as "name[0]", elements past the first are reachable as "name[i]" too
+        if (uniform_name.size() > 3 && uniform_name.compare(uniform_name.size() - 3, 3, "[0]") == 0)
+        {
+            std::string base = uniform_name.substr(0, uniform_name.size() - 3);
+            uniform_locations.push_back({uniform_id(base.c_str()), location});
+            for (int element = 1; element < size; element++)
+            {
+                std::string element_name = base + "[" + std::to_string(element) + "]";
+                uniform_locations.push_back({uniform_id(element_name.c_str()), glGetUniformLocation(program_id, element_name.c_str())});
+            }
+        }
+    }
+
+    std::sort(uniform_locations.begin(), uniform_locations.end());
+    for (size_t i = 1; i < uniform_locations.size(); i++)
+    {
+        if (uniform_locations[i].first == uniform_locations[i - 1].first)
+        {
+            std::cout << "ERROR::SHADER::UNIFORM_NAME_HASH_COLLISION" << std::endl;
+        }
+    }
+}
+
+void Shader::bind_uniform_blocks()
+{
+    // GLSL 330 has no binding layout qualifier, so blocks are assigned their binding points here
+    unsigned int frame_block = glGetUniformBlockIndex(program_id, "Frame");
+    if (frame_block != GL_INVALID_INDEX)
+    {
+        glUniformBlockBinding(program_id, frame_block, FRAME_BLOCK_BINDING);
+    }
 }
 
-void Shader::check_compile_errors(unsigned int shader, std::string type)
+bool Shader::check_compile_errors(unsigned int shader, std::string type)
 {
     int success;
     char info_log[log_size];
@@ -130,4 +356,28 @@ void Shader::check_compile_errors(unsigned int shader, std::string type)
                       << info_log << "\n -- --------------------------------------------------- -- " << std::endl;
         }
     }
+    return success;
+}
+
+void ShaderBatch::add(Shader &shader)
+{
+    shaders.push_back(&shader);
+}
+
+bool ShaderBatch::is_ready()
+{
+    bool ready = true;
+    for (Shader *shader : shaders)
+    {
+        ready = shader->is_ready() && ready;
+    }
+    return ready;
+}
+
+void ShaderBatch::finish()
+{
+    for (Shader *shader : shaders)
+    {
+        shader->finish();
+    }
 }
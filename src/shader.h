@@ -1,15 +1,39 @@
 #ifndef SHADER_H
 #define SHADER_H
 
+#include <cstdint>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "shader_source.h"
+
+// 32 bit FNV-1a hash of a uniform name. Usable at compile time, so hot code can name uniforms with constants like
+// `const UniformId MODEL = uniform_id("model");` and never build or compare strings while drawing.
+typedef std::uint32_t UniformId;
+constexpr UniformId uniform_id(const char *name)
+{
+    UniformId hash = 2166136261u;
+    for (; *name; name++)
+    {
+        hash = (hash ^ static_cast<unsigned char>(*name)) * 16777619u;
+    }
+    return hash;
+}
+
+// binding point of the per frame uniform block "Frame" (see FrameUniforms), assigned at link time
+const unsigned int FRAME_BLOCK_BINDING = 0;
+
+class ShaderCache;
+
 class Shader
 {
 public:
@@ -17,18 +41,97 @@ public:
     unsigned int program_id;
 
     // methods
-    Shader(const char *vertex_shader_path, const char *fragment_shader_path);
+    // With deferred set, compiling and linking is only submitted to the driver and the constructor returns without
+    // waiting for it, which lets drivers with KHR_parallel_shader_compile work on many programs at once. The program
+    // becomes usable once is_ready() returns true, use() waits for it if it is still being built.
+    Shader(const char *vertex_shader_path, const char *fragment_shader_path, bool deferred = false);
+    // from already preprocessed sources, see ShaderLibrary
+    Shader(const ShaderSource &source, bool deferred = false);
     ~Shader();
     void use();
+
+    // checks whether a deferred build is done and finishes it if so. Never blocks with KHR_parallel_shader_compile,
+    // without it the status query waits for the driver anyway, so this finishes right away.
+    bool is_ready();
+    // waits for the program, checks for errors and sets up the uniform tables
+    void finish();
+
+    // Starts rebuilding the program from its files in the background, the current program stays in use until
+    // apply_reload() swaps in the new one. Uniforms set only once have to be set again after a swap.
+    bool reload();
+    // call at a frame boundary, swaps in a finished rebuild and returns true. A rebuild that fails to compile or link
+    // is dropped with its log printed and the previous program kept.
+    bool apply_reload();
+    // the files the program was built from, includes too. Empty for programs not built from files.
+    const std::vector<std::string> &get_files() const { return files; }
+
+    // the setters look the location up in the table of active uniforms built at link time, no GL name queries.
+    // Uniforms the program doesn't use are silently ignored like with a -1 location.
     void set_bool(const std::string &name, bool value) const;
     void set_int(const std::string &name, int value) const;
     void set_float(const std::string &name, float value) const;
     void set_vec3(const std::string &name, glm::vec3 value) const;
-    void set_mat4(const std::string &name, glm::mat4 &value) const;
+    void set_mat4(const std::string &name, const glm::mat4 &value) const;
+
+    // the same with a pre-hashed name, for per draw calls
+    void set_bool(UniformId id, bool value) const;
+    void set_int(UniformId id, int value) const;
+    void set_float(UniformId id, float value) const;
+    void set_vec3(UniformId id, glm::vec3 value) const;
+    void set_mat4(UniformId id, const glm::mat4 &value) const;
+
+    // -1 if the program has no active uniform of that name
+    int get_uniform_location(UniformId id) const;
 
 private:
     const int log_size = 1024;
-    void check_compile_errors(unsigned int shader, std::string type);
+    // (name hash, location) of every active uniform, sorted by hash
+    std::vector<std::pair<UniformId, int>> uniform_locations;
+
+    // a program with the shaders it is linked from until it is finished, and where to store its binary once it's linked
+    struct Build
+    {
+        unsigned int program = 0;
+        unsigned int vertex_shader = 0;
+        unsigned int fragment_shader = 0;
+        std::unique_ptr<ShaderCache> cache;
+    };
+    // the program in use, still being built while pending, and the rebuild started by reload()
+    Build current;
+    bool pending = false;
+    Build next;
+    bool reloading = false;
+
+    // where the sources came from, to rebuild them
+    std::string vertex_path;
+    std::string fragment_path;
+    std::string defines;
+    std::vector<std::string> files;
+
+    // prints the info log on failure, returns whether the shader compiled or the program linked
+    bool check_compile_errors(unsigned int shader, std::string type);
+    void build(const ShaderSource &source, bool deferred);
+    static bool read_source(const std::string &vertex_path, const std::string &fragment_path, const std::string &defines, ShaderSource &source);
+    void start_build(const ShaderSource &source, Build &build);
+    bool build_done(const Build &build) const;
+    bool finish_build(Build &build);
+    static void discard_build(Build &build);
+    void load_uniform_locations();
+    void bind_uniform_blocks();
+};
+
+// Shaders built together, constructed deferred and polled from the render loop until all of them are ready.
+class ShaderBatch
+{
+public:
+    void add(Shader &shader);
+    // finishes every shader that is done, true once all are
+    bool is_ready();
+    // waits for all of them
+    void finish();
+
+private:
+    std::vector<Shader *> shaders;
 };
 
 #endif
\ No newline at end of file
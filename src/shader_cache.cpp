@@ -0,0 +1,164 @@
+#include "shader_cache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "gl_extensions.h"
+#include "temporary_path.h"
+
+namespace
+{
+    // bump whenever the layout below changes
+    const uint32_t cache_version = 1;
+    const char cache_magic[8] = {'L', 'O', 'G', 'L', 'P', 'R', 'O', 'G'};
+    const char *cache_directory = "shader_cache";
+
+    // file layout: header | binary
+    struct CacheHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t binary_format;
+        uint64_t key;
+        uint64_t binary_size;
+    };
+
+    // 64 bit FNV-1a, a terminating zero is hashed after every part so "ab" + "c" and "a" + "bc" differ
+    void hash_append(uint64_t &hash, const char *text)
+    {
+        for (const char *c = text; *c; c++)
+        {
+            hash = (hash ^ static_cast<unsigned char>(*c)) * 1099511628211ull;
+        }
+        hash *= 1099511628211ull;
+    }
+
+    const char *gl_string(GLenum name)
+    {
+        const char *value = reinterpret_cast<const char *>(glGetString(name));
+        return value ? value : "";
+    }
+}
+
+ShaderCache::ShaderCache(const std::string &vertex_source, const std::string &fragment_source, const std::string &defines)
+{
+    key = 14695981039346656037ull;
+    hash_append(key, vertex_source.c_str());
+    hash_append(key, fragment_source.c_str());
+    hash_append(key, defines.c_str());
+    hash_append(key, gl_string(GL_VENDOR));
+    hash_append(key, gl_string(GL_RENDERER));
+    hash_append(key, gl_string(GL_VERSION));
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.programcache", static_cast<unsigned long long>(key));
+    cache_path = (std::filesystem::path(cache_directory) / name).string();
+}
+
+unsigned int ShaderCache::load() const
+{
+    const GLExtensions &extensions = GLExtensions::get();
+    if (!extensions.program_binary)
+    {
+        return 0;
+    }
+
+    std::ifstream file(cache_path, std::ios::binary);
+    CacheHeader header;
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) || std::memcmp(header.magic, cache_magic, sizeof(cache_magic)) != 0 ||
+        header.version != cache_version || header.key != key)
+    {
+        return 0;
+    }
+    // the size comes from disk, a truncated or corrupt file must not turn into a huge allocation
+    std::error_code error;
+    uint64_t file_size = std::filesystem::file_size(cache_path, error);
+    if (error || header.binary_size == 0 || header.binary_size != file_size - sizeof(header))
+    {
+        std::cout << "ERROR::SHADER_CACHE::MALFORMED_FILE: " << cache_path << std::endl;
+        return 0;
+    }
+    std::vector<char> binary(header.binary_size);
+    if (!file.read(binary.data(), binary.size()))
+    {
+        return 0;
+    }
+
+    // the driver may refuse binaries of other builds even with matching strings, that only costs a compile
+    unsigned int program = glCreateProgram();
+    extensions.load_program_binary(program, header.binary_format, binary.data(), static_cast<GLsizei>(binary.size()));
+    int success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+bool ShaderCache::save(unsigned int program) const
+{
+    const GLExtensions &extensions = GLExtensions::get();
+    if (!extensions.program_binary)
+    {
+        return false;
+    }
+
+    int length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+    {
+        return false;
+    }
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    extensions.get_program_binary(program, length, &length, &format, binary.data());
+
+    CacheHeader header;
+    std::memcpy(header.magic, cache_magic, sizeof(cache_magic));
+    header.version = cache_version;
+    header.binary_format = format;
+    header.key = key;
+    header.binary_size = static_cast<uint64_t>(length);
+
+    std::error_code error;
+    std::filesystem::create_directories(cache_directory, error);
+    // written under a temporary name and renamed, so a crash never leaves a truncated file behind. Saves only happen
+    // on the GL thread, but other instances of the program share the cache directory
+    std::string temp_path = temporary_path(cache_path);
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(binary.data(), length);
+        if (!file)
+        {
+            std::cout << "ERROR::SHADER_CACHE::WRITE_FAILED: " << cache_path << std::endl;
+            file.close();
+            std::filesystem::remove(temp_path, error);
+            return false;
+        }
+    }
+    std::filesystem::rename(temp_path, cache_path, error);
+    if (error)
+    {
+        std::filesystem::remove(temp_path, error);
+        return false;
+    }
+    return true;
+}
+
+void ShaderCache::prepare(unsigned int program)
+{
+    const GLExtensions &extensions = GLExtensions::get();
+    if (extensions.program_binary)
+    {
+        extensions.program_parameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+}
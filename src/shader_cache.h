@@ -0,0 +1,30 @@
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include <cstdint>
+#include <string>
+
+// On-disk cache of linked program binaries, one "<key>.programcache" file per program in shader_cache/.
+// The key hashes the shader sources, the defines they were built with and the driver's vendor, renderer and
+// version strings, so a driver update or an edited shader simply misses the cache. Needs ARB_get_program_binary,
+// without it load() always misses and save() does nothing.
+class ShaderCache
+{
+public:
+    // must be constructed on the GL thread, the driver strings are part of the key
+    ShaderCache(const std::string &vertex_source, const std::string &fragment_source, const std::string &defines = "");
+
+    // creates a program from the cached binary, returns 0 if there is none or the driver rejects it
+    unsigned int load() const;
+    // stores the binary of a successfully linked program, returns false if it could not be retrieved or written
+    bool save(unsigned int program) const;
+
+    // to be set on programs before linking so the driver keeps their binary retrievable
+    static void prepare(unsigned int program);
+
+private:
+    std::uint64_t key;
+    std::string cache_path;
+};
+
+#endif
@@ -0,0 +1,59 @@
+#include "shader_library.h"
+
+#include <algorithm>
+
+#include "file_watcher.h"
+
+Shader &ShaderLibrary::get(const std::string &vertex_path, const std::string &fragment_path, const std::vector<std::string> &defines)
+{
+    auto found = sources.find(vertex_path + '\n' + fragment_path);
+    if (found == sources.end())
+    {
+        Sources read;
+        resolve_includes(vertex_path, read.vertex, read.files);
+        resolve_includes(fragment_path, read.fragment, read.files);
+        read.hash = hash_sources(read.vertex, read.fragment);
+        found = sources.emplace(vertex_path + '\n' + fragment_path, std::move(read)).first;
+    }
+
+    std::string define_set = make_define_set(defines);
+    std::unique_ptr<Shader> &variant = variants[{found->second.hash, define_set}];
+    if (!variant)
+    {
+        ShaderSource source;
+        source.vertex = inject_defines(found->second.vertex, define_set);
+        source.fragment = inject_defines(found->second.fragment, define_set);
+        source.defines = define_set;
+        // lets the variant rebuild itself on reload()
+        source.vertex_path = vertex_path;
+        source.fragment_path = fragment_path;
+        source.files = found->second.files;
+        variant.reset(new Shader(source, true));
+    }
+    return *variant;
+}
+
+void ShaderLibrary::invalidate(const std::vector<std::string> &changed_files)
+{
+    for (auto it = sources.begin(); it != sources.end();)
+    {
+        const std::vector<std::string> &files = it->second.files;
+        bool affected = std::any_of(files.begin(), files.end(), [&](const std::string &file)
+                                    { return std::find(changed_files.begin(), changed_files.end(), FileWatcher::normalize(file)) != changed_files.end(); });
+        if (!affected)
+        {
+            ++it;
+            continue;
+        }
+
+        // reverting the edit brings the old hash back, which mustn't find variants that reloaded to the edited text
+        std::uint64_t hash = it->second.hash;
+        auto variant = variants.lower_bound({hash, std::string()});
+        while (variant != variants.end() && variant->first.first == hash)
+        {
+            retired.push_back(std::move(variant->second));
+            variant = variants.erase(variant);
+        }
+        it = sources.erase(it);
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef SHADER_LIBRARY_H
+#define SHADER_LIBRARY_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "shader.h"
+
+// Variants of shader programs specialized with #define sets, compiled on first request and cached by
+// (source hash, define set). Materials ask for the features they use and get a program with the other
+// branches compiled out; programs with identical sources and defines are only ever built once.
+class ShaderLibrary
+{
+public:
+    // the program built from the two files with defines ("NAME" or "NAME=VALUE", in any order). A new variant is
+    // built deferred, so several can compile at once; the returned reference stays valid for the library's lifetime.
+    Shader &get(const std::string &vertex_path, const std::string &fragment_path, const std::vector<std::string> &defines = {});
+
+    // Forgets the sources that include any of the changed files (paths as FileWatcher reports them), so the next
+    // get() reads them again. Variants built from the old text stay valid for whoever holds them, but are no longer
+    // handed out for new requests.
+    void invalidate(const std::vector<std::string> &changed_files);
+
+    size_t size() const { return variants.size(); }
+
+private:
+    // include-resolved sources of a pair of files, read once
+    struct Sources
+    {
+        std::string vertex;
+        std::string fragment;
+        std::vector<std::string> files;
+        std::uint64_t hash;
+    };
+
+    std::unordered_map<std::string, Sources> sources;
+    std::map<std::pair<std::uint64_t, std::string>, std::unique_ptr<Shader>> variants;
+    // variants of invalidated sources, kept alive because references to them are still out there
+    std::vector<std::unique_ptr<Shader>> retired;
+};
+
+#endif
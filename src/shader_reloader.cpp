@@ -0,0 +1,50 @@
+#include "shader_reloader.h"
+
+#include <algorithm>
+
+void ShaderReloader::watch(Shader &shader)
+{
+    shaders.push_back(&shader);
+    for (const std::string &file : shader.get_files())
+    {
+        watcher.add(file);
+    }
+}
+
+void ShaderReloader::watch(ShaderLibrary &library)
+{
+    libraries.push_back(&library);
+}
+
+void ShaderReloader::update()
+{
+    std::vector<std::string> changed = watcher.poll();
+    if (!changed.empty())
+    {
+        for (ShaderLibrary *library : libraries)
+        {
+            library->invalidate(changed);
+        }
+    }
+    for (Shader *shader : shaders)
+    {
+        if (!changed.empty())
+        {
+            const std::vector<std::string> &files = shader->get_files();
+            bool affected = std::any_of(files.begin(), files.end(), [&](const std::string &file)
+                                        { return std::find(changed.begin(), changed.end(), FileWatcher::normalize(file)) != changed.end(); });
+            if (affected && shader->reload())
+            {
+                // the edit may have added includes
+                for (const std::string &file : shader->get_files())
+                {
+                    watcher.add(file);
+                }
+            }
+        }
+        if (shader->apply_reload())
+        {
+            std::cout << "shader program " << shader->program_id << " reloaded" << std::endl;
+        }
+    }
+}
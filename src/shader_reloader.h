@@ -0,0 +1,31 @@
+#ifndef SHADER_RELOADER_H
+#define SHADER_RELOADER_H
+
+#include <vector>
+
+#include "file_watcher.h"
+#include "shader.h"
+#include "shader_library.h"
+
+// Rebuilds shaders whose source files changed on disk while the program keeps running. The rebuild compiles in the
+// background next to the old program, which stays in use until the new one linked and is swapped in at a frame
+// boundary; a broken edit only prints its log.
+class ShaderReloader
+{
+public:
+    // the shader has to outlive the reloader or stop being watched before that
+    void watch(Shader &shader);
+    // invalidates the library's sources whenever a watched file changes, so variants requested after an edit are
+    // built from the new text. The files are watched through the variants passed to watch(Shader &).
+    void watch(ShaderLibrary &library);
+
+    // call once per frame on the GL thread before drawing
+    void update();
+
+private:
+    FileWatcher watcher;
+    std::vector<Shader *> shaders;
+    std::vector<ShaderLibrary *> libraries;
+};
+
+#endif
@@ -0,0 +1,126 @@
+#include "shader_source.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+    // the quoted file name of an #include line, empty for any other line
+    std::string include_target(const std::string &line)
+    {
+        size_t position = line.find_first_not_of(" \t");
+        if (position == std::string::npos || line[position] != '#')
+        {
+            return "";
+        }
+        position = line.find_first_not_of(" \t", position + 1);
+        if (position == std::string::npos || line.compare(position, 7, "include") != 0)
+        {
+            return "";
+        }
+        size_t open = line.find('"', position + 7);
+        size_t close = open == std::string::npos ? std::string::npos : line.find('"', open + 1);
+        return close == std::string::npos ? "" : line.substr(open + 1, close - open - 1);
+    }
+
+    bool resolve(const std::filesystem::path &path, std::string &source, std::vector<std::string> &files, std::vector<std::string> &stack)
+    {
+        std::string name = path.lexically_normal().string();
+        if (std::find(stack.begin(), stack.end(), name) != stack.end())
+        {
+            std::cout << "ERROR::SHADER::RECURSIVE_INCLUDE: " << name << std::endl;
+            return false;
+        }
+        std::ifstream file(path);
+        if (!file)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << name << std::endl;
+            return false;
+        }
+        files.push_back(name);
+        stack.push_back(name);
+
+        std::string line;
+        unsigned int line_number = 0;
+        bool success = true;
+        while (success && std::getline(file, line))
+        {
+            line_number++;
+            std::string target = include_target(line);
+            if (target.empty())
+            {
+                source += line;
+                source += '\n';
+                continue;
+            }
+            source += "#line 1\n";
+            success = resolve(path.parent_path() / target, source, files, stack);
+            source += "#line " + std::to_string(line_number + 1) + "\n";
+        }
+
+        stack.pop_back();
+        return success;
+    }
+}
+
+bool resolve_includes(const std::string &path, std::string &source, std::vector<std::string> &files)
+{
+    std::vector<std::string> stack;
+    source.clear();
+    return resolve(path, source, files, stack);
+}
+
+std::string make_define_set(std::vector<std::string> defines)
+{
+    std::sort(defines.begin(), defines.end());
+    defines.erase(std::unique(defines.begin(), defines.end()), defines.end());
+    std::string set;
+    for (const std::string &define : defines)
+    {
+        set += define;
+        set += '\n';
+    }
+    return set;
+}
+
+std::string inject_defines(const std::string &source, const std::string &define_set)
+{
+    if (define_set.empty())
+    {
+        return source;
+    }
+
+    // #version has to stay the first statement, everything else goes after it
+    size_t version = source.find("#version");
+    size_t insert = version == std::string::npos ? 0 : source.find('\n', version);
+    insert = insert == std::string::npos ? source.size() : insert + 1;
+    unsigned int next_line = static_cast<unsigned int>(std::count(source.begin(), source.begin() + insert, '\n')) + 1;
+
+    std::string defines;
+    std::istringstream entries(define_set);
+    std::string entry;
+    while (std::getline(entries, entry))
+    {
+        size_t equals = entry.find('=');
+        defines += "#define " + (equals == std::string::npos ? entry : entry.substr(0, equals) + " " + entry.substr(equals + 1)) + "\n";
+    }
+    defines += "#line " + std::to_string(next_line) + "\n";
+    return source.substr(0, insert) + defines + source.substr(insert);
+}
+
+std::uint64_t hash_sources(const std::string &vertex, const std::string &fragment)
+{
+    std::uint64_t hash = 14695981039346656037ull;
+    for (const std::string *part : {&vertex, &fragment})
+    {
+        for (char c : *part)
+        {
+            hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+        }
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
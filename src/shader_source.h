@@ -0,0 +1,37 @@
+#ifndef SHADER_SOURCE_H
+#define SHADER_SOURCE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// GLSL ready to compile: both stages with includes resolved and defines injected
+struct ShaderSource
+{
+    std::string vertex;
+    std::string fragment;
+    // the define set the stages were specialized with, see make_define_set
+    std::string defines;
+
+    // where the stages were read from and every file that went into them, includes too
+    std::string vertex_path;
+    std::string fragment_path;
+    std::vector<std::string> files;
+};
+
+// reads a GLSL file and splices in every `#include "file"` line, resolved relative to the including file and
+// recursively. #line directives keep compiler messages pointing at the right lines. Appends every file read to
+// files and returns false if one is missing or includes itself.
+bool resolve_includes(const std::string &path, std::string &source, std::vector<std::string> &files);
+
+// canonical form of a list of "NAME" or "NAME=VALUE" defines: sorted, duplicates removed, joined by newlines,
+// so the same set always gives the same string no matter the order it was written in
+std::string make_define_set(std::vector<std::string> defines);
+
+// inserts a #define line per entry of the define set right after the #version line
+std::string inject_defines(const std::string &source, const std::string &define_set);
+
+// 64 bit FNV-1a over the parts, for keying sources
+std::uint64_t hash_sources(const std::string &vertex, const std::string &fragment);
+
+#endif
@@ -0,0 +1,23 @@
+#include "temporary_path.h"
+
+#include <atomic>
+#include <functional>
+#include <thread>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+std::string temporary_path(const std::string &path)
+{
+    static std::atomic<unsigned int> counter(0);
+#ifdef _WIN32
+    int process = _getpid();
+#else
+    int process = static_cast<int>(getpid());
+#endif
+    size_t thread = std::hash<std::thread::id>()(std::this_thread::get_id());
+    return path + "." + std::to_string(process) + "." + std::to_string(thread) + "." + std::to_string(counter++) + ".tmp";
+}
@@ -0,0 +1,11 @@
+#ifndef TEMPORARY_PATH_H
+#define TEMPORARY_PATH_H
+
+#include <string>
+
+// A name next to path for writing a file before renaming it over path, unique per process, thread and call.
+// Several instances of the program, or several threads of one, may write the same cache file at once; with a
+// shared temporary name one writer would truncate what the other is about to rename.
+std::string temporary_path(const std::string &path);
+
+#endif
@@ -0,0 +1,195 @@
+#include "texture_array.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <tuple>
+
+#include <glad/glad.h>
+
+#include "gl_state.h"
+#include "stb/stb_image.h"
+#include "texture_cache.h"
+#include "thread_pool.h"
+
+namespace
+{
+    // the minimum GL_MAX_ARRAY_TEXTURE_LAYERS of GL 3.3, larger sets are split into several groups
+    const unsigned int max_layers = 256;
+
+    // what two materials need to have in common to share arrays: per texture slot the type, size, format and levels
+    typedef std::vector<std::tuple<std::string, int, int, uint32_t, size_t>> Signature;
+
+    // the texture from the cooked file, cooked and stored if there is none. Everything happens in the background
+    // here, so unlike the registry a miss waits for the compression.
+    bool load_texture(const std::string &path, const TextureParams &params, CookedTexture &texture)
+    {
+        TextureCache cache(path, params.cook_flags());
+        if (cache.load(texture))
+        {
+            return true;
+        }
+
+        int width, height, n_components;
+        stbi_set_flip_vertically_on_load_thread(params.flip_vertically);
+        unsigned char *data = stbi_load(path.c_str(), &width, &height, &n_components, 0);
+        if (!data)
+        {
+            return false;
+        }
+        cook_texture(data, width, height, n_components, params.normal_map, texture);
+        stbi_image_free(data);
+
+        if (params.compress)
+        {
+            CookedTexture uncompressed = std::move(texture);
+            compress_texture(uncompressed, texture);
+        }
+        cache.save(texture);
+        return true;
+    }
+}
+
+void build_material_arrays(const std::vector<MaterialData> &materials, const std::vector<bool> &used, const std::string &directory,
+                           bool compress, MaterialArrays &arrays)
+{
+    arrays = MaterialArrays();
+    arrays.material_group.assign(materials.size(), -1);
+    arrays.material_layer.assign(materials.size(), 0);
+
+    // decode every file once no matter how many materials use it, cooked like the registry does it
+    std::map<std::string, size_t> files;
+    std::vector<std::string> paths;
+    std::vector<TextureParams> params;
+    std::vector<std::vector<size_t>> material_files(materials.size());
+    for (size_t i = 0; i < materials.size(); i++)
+    {
+        if (!used[i])
+        {
+            continue;
+        }
+        for (const TextureRef &ref : materials[i].textures)
+        {
+            auto inserted = files.insert({ref.path, paths.size()});
+            if (inserted.second)
+            {
+                paths.push_back(ref.path);
+                params.emplace_back();
+                params.back().compress = compress;
+                params.back().normal_map = ref.type == "texture_normal";
+            }
+            material_files[i].push_back(inserted.first->second);
+        }
+    }
+    std::vector<CookedTexture> decoded(paths.size());
+    ThreadPool::shared().parallel_for(paths.size(), [&](size_t k)
+                                      {
+                                          if (!load_texture(directory + '/' + paths[k], params[k], decoded[k]))
+                                          {
+                                              std::cout << "Texture failed to load at path: " << paths[k] << std::endl;
+                                          }
+                                      });
+
+    // group the materials by signature, in material order so the layers come out the same on every load
+    std::map<Signature, std::vector<size_t>> candidates;
+    for (size_t i = 0; i < materials.size(); i++)
+    {
+        if (!used[i])
+        {
+            continue;
+        }
+        Signature signature;
+        bool complete = !materials[i].textures.empty();
+        for (size_t j = 0; j < materials[i].textures.size(); j++)
+        {
+            const CookedTexture &texture = decoded[material_files[i][j]];
+            complete = complete && !texture.levels.empty();
+            signature.emplace_back(materials[i].textures[j].type, texture.width, texture.height, texture.internal_format, texture.levels.size());
+        }
+        if (complete)
+        {
+            candidates[signature].push_back(i);
+        }
+    }
+
+    for (const auto &candidate : candidates)
+    {
+        const std::vector<size_t> &members = candidate.second;
+        for (size_t start = 0; start < members.size(); start += max_layers)
+        {
+            unsigned int layers = static_cast<unsigned int>(std::min<size_t>(members.size() - start, max_layers));
+            int group = static_cast<int>(arrays.groups.size());
+            std::vector<TextureArrayData> slots(candidate.first.size());
+            for (size_t slot = 0; slot < slots.size(); slot++)
+            {
+                TextureArrayData &array = slots[slot];
+                array.type = std::get<0>(candidate.first[slot]);
+                array.layers = layers;
+
+                // same size and format, so the same level sizes for every layer
+                const CookedTexture &first = decoded[material_files[members[start]][slot]];
+                array.texture.internal_format = first.internal_format;
+                array.texture.format = first.format;
+                array.texture.width = first.width;
+                array.texture.height = first.height;
+                array.texture.levels.resize(first.levels.size());
+                for (size_t level = 0; level < first.levels.size(); level++)
+                {
+                    TextureLevel &data = array.texture.levels[level];
+                    data.width = first.levels[level].width;
+                    data.height = first.levels[level].height;
+                    size_t layer_size = first.levels[level].data.size();
+                    data.data.resize(layer_size * layers);
+                    for (unsigned int layer = 0; layer < layers; layer++)
+                    {
+                        const CookedTexture &texture = decoded[material_files[members[start + layer]][slot]];
+                        std::memcpy(data.data.data() + layer * layer_size, texture.levels[level].data.data(), layer_size);
+                    }
+                }
+            }
+            for (unsigned int layer = 0; layer < layers; layer++)
+            {
+                arrays.material_group[members[start + layer]] = group;
+                arrays.material_layer[members[start + layer]] = layer;
+            }
+            arrays.groups.push_back(std::move(slots));
+        }
+    }
+}
+
+void upload_texture_array(TextureArrayData &data, TextureResource &texture)
+{
+    texture.target = GL_TEXTURE_2D_ARRAY;
+    glGenTextures(1, &texture.id);
+
+    const CookedTexture &cooked = data.texture;
+    GLState::get().bind_texture(0, GL_TEXTURE_2D_ARRAY, texture.id);
+    // rows of single channel and RGB layers aren't necessarily 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (size_t level = 0; level < cooked.levels.size(); level++)
+    {
+        const TextureLevel &layers = cooked.levels[level];
+        if (cooked.is_compressed())
+        {
+            glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, GLint(level), cooked.internal_format, layers.width, layers.height, data.layers, 0,
+                                   GLsizei(layers.data.size()), layers.data.data());
+        }
+        else
+        {
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, GLint(level), cooked.internal_format, layers.width, layers.height, data.layers, 0, cooked.format,
+                         GL_UNSIGNED_BYTE, layers.data.data());
+        }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, GLint(cooked.levels.size()) - 1);
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    data.texture = CookedTexture();
+    texture.resident = true;
+}
@@ -0,0 +1,43 @@
+#ifndef TEXTURE_ARRAY_H
+#define TEXTURE_ARRAY_H
+
+#include <string>
+#include <vector>
+
+#include "model_data.h"
+#include "texture_cooker.h"
+#include "texture_registry.h"
+
+// the layers of one GL_TEXTURE_2D_ARRAY, every level holds the data of all layers back to back
+struct TextureArrayData
+{
+    std::string type;
+    unsigned int layers = 0;
+    CookedTexture texture;
+};
+
+// The textures of a model's materials packed into arrays. Materials whose texture lists match in type, size and format
+// form a group, every texture slot of a group is one array and a material is a layer of it. Meshes of the same group
+// then differ only in a vertex attribute and can be drawn together.
+struct MaterialArrays
+{
+    // arrays of every group, one per texture slot in the order of the materials' texture lists
+    std::vector<std::vector<TextureArrayData>> groups;
+    // per material: its group, or -1 for materials that are unused, have no textures or one that failed to load,
+    // and its layer
+    std::vector<int> material_group;
+    std::vector<unsigned int> material_layer;
+};
+
+// Decodes the textures of the materials flagged in used on the thread pool and packs them, a material that matches
+// no other gets a group with a single layer so every textured material is drawn through arrays. The layers are the
+// cooked levels from the texture cache, cooked first where it misses (see TextureCache), and block compressed with
+// compress. Materials no mesh uses are skipped before anything is decoded.
+void build_material_arrays(const std::vector<MaterialData> &materials, const std::vector<bool> &used, const std::string &directory,
+                           bool compress, MaterialArrays &arrays);
+
+// uploads the layers with a full mip chain into texture and makes it resident, must be called on the GL thread.
+// The handle can be handed out before, so an array is one upload step like a registry texture. Frees the data.
+void upload_texture_array(TextureArrayData &data, TextureResource &texture);
+
+#endif
@@ -0,0 +1,195 @@
+#include "texture_cache.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "mapped_file.h"
+#include "temporary_path.h"
+
+namespace
+{
+    // bump whenever the layout below or the cooking that produces the levels changes
+    const uint32_t cache_version = 4;
+    const char cache_magic[8] = {'L', 'O', 'G', 'L', 'T', 'E', 'X', 'C'};
+
+    // file layout: header | per level: image_size, data padded to 4 bytes
+    struct CacheHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t cook_flags;
+        uint64_t source_size;
+        int64_t source_mtime;
+        uint32_t internal_format;
+        uint32_t format;
+        uint32_t width;
+        uint32_t height;
+        uint32_t level_count;
+        uint32_t padding;
+    };
+
+    uint64_t align_up(uint64_t value)
+    {
+        return (value + 3) & ~uint64_t(3);
+    }
+}
+
+TextureCache::TextureCache(const std::string &source_path, unsigned int cook_flags)
+    : source_path(source_path), cache_path(source_path + "." + std::to_string(cook_flags) + ".texcache"), cook_flags(cook_flags)
+{
+}
+
+bool TextureCache::source_stamp(unsigned long long &size, long long &mtime) const
+{
+    std::error_code error;
+    size = std::filesystem::file_size(source_path, error);
+    if (error)
+    {
+        return false;
+    }
+    std::filesystem::file_time_type time = std::filesystem::last_write_time(source_path, error);
+    if (error)
+    {
+        return false;
+    }
+    mtime = static_cast<long long>(time.time_since_epoch().count());
+    return true;
+}
+
+bool TextureCache::load(CookedTexture &texture) const
+{
+    unsigned long long source_size;
+    long long source_mtime;
+    if (!source_stamp(source_size, source_mtime))
+    {
+        return false;
+    }
+
+    MappedFile file;
+    if (!file.open(cache_path) || file.size() < sizeof(CacheHeader))
+    {
+        return false;
+    }
+    const unsigned char *bytes = file.data();
+
+    CacheHeader header;
+    std::memcpy(&header, bytes, sizeof(header));
+    if (std::memcmp(header.magic, cache_magic, sizeof(cache_magic)) != 0 || header.version != cache_version ||
+        header.cook_flags != cook_flags || header.source_size != source_size || header.source_mtime != source_mtime)
+    {
+        return false;
+    }
+    // the levels are uploaded as they are, so the formats have to be ones the cooker writes and the chain can't be
+    // longer than the halvings down to 1x1
+    uint32_t max_levels = 1;
+    while ((std::max(header.width, header.height) >> max_levels) != 0)
+    {
+        max_levels++;
+    }
+    if (header.width == 0 || header.height == 0 || header.width > 65536 || header.height > 65536 || header.level_count == 0 ||
+        header.level_count > max_levels || level_size(header.internal_format, header.format, 1, 1) == 0)
+    {
+        std::cout << "ERROR::TEXTURE_CACHE::MALFORMED_FILE: " << cache_path << std::endl;
+        return false;
+    }
+
+    texture.internal_format = header.internal_format;
+    texture.format = header.format;
+    texture.width = int(header.width);
+    texture.height = int(header.height);
+    texture.levels.clear();
+    texture.levels.resize(header.level_count);
+
+    uint64_t offset = sizeof(CacheHeader);
+    for (uint32_t i = 0; i < header.level_count; i++)
+    {
+        uint32_t image_size;
+        if (offset + sizeof(image_size) > file.size())
+        {
+            std::cout << "ERROR::TEXTURE_CACHE::MALFORMED_FILE: " << cache_path << std::endl;
+            texture.levels.clear();
+            return false;
+        }
+        std::memcpy(&image_size, bytes + offset, sizeof(image_size));
+        offset += sizeof(image_size);
+        TextureLevel &level = texture.levels[i];
+        level.width = std::max(int(header.width >> i), 1);
+        level.height = std::max(int(header.height >> i), 1);
+        if (offset + image_size > file.size() || image_size != level_size(header.internal_format, header.format, level.width, level.height))
+        {
+            std::cout << "ERROR::TEXTURE_CACHE::MALFORMED_FILE: " << cache_path << std::endl;
+            texture.levels.clear();
+            return false;
+        }
+
+        level.data.assign(bytes + offset, bytes + offset + image_size);
+        offset = align_up(offset + image_size);
+    }
+    return true;
+}
+
+bool TextureCache::save(const CookedTexture &texture) const
+{
+    CacheHeader header = {};
+    std::memcpy(header.magic, cache_magic, sizeof(cache_magic));
+    header.version = cache_version;
+    header.cook_flags = cook_flags;
+    unsigned long long source_size;
+    long long source_mtime;
+    if (!source_stamp(source_size, source_mtime))
+    {
+        return false;
+    }
+    header.source_size = source_size;
+    header.source_mtime = source_mtime;
+    header.internal_format = texture.internal_format;
+    header.format = texture.format;
+    header.width = uint32_t(texture.width);
+    header.height = uint32_t(texture.height);
+    header.level_count = uint32_t(texture.levels.size());
+
+    // write to a temporary file first so a crash never leaves a truncated cache behind. The registry and the
+    // texture arrays may cook the same image at once, so the name is unique to this writer
+    std::string temp_path = temporary_path(cache_path);
+    std::error_code error;
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            std::cout << "ERROR::TEXTURE_CACHE::FILE_NOT_WRITABLE: " << cache_path << std::endl;
+            return false;
+        }
+
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        const char padding[4] = {};
+        for (const TextureLevel &level : texture.levels)
+        {
+            uint32_t image_size = uint32_t(level.data.size());
+            file.write(reinterpret_cast<const char *>(&image_size), sizeof(image_size));
+            file.write(reinterpret_cast<const char *>(level.data.data()), level.data.size());
+            file.write(padding, align_up(image_size) - image_size);
+        }
+
+        if (!file)
+        {
+            std::cout << "ERROR::TEXTURE_CACHE::FILE_NOT_WRITABLE: " << cache_path << std::endl;
+            file.close();
+            std::filesystem::remove(temp_path, error);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(temp_path, cache_path, error);
+    if (error)
+    {
+        std::cout << "ERROR::TEXTURE_CACHE::FILE_NOT_WRITABLE: " << cache_path << std::endl;
+        std::filesystem::remove(temp_path, error);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,32 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <string>
+
+#include "texture_cooker.h"
+
+// Cooked form of a texture, stored next to the source image as "<image>.<cook flags>.texcache" so every set of
+// options the image is cooked with keeps its own file. The container follows KTX: a header with the GL formats,
+// size and level count, then every level as its byte size followed by its data, padded to 4 bytes. Cooking is done
+// once on a miss, later runs upload the levels without decoding anything. The cache is ignored and rewritten
+// whenever the format version or the source image's size/modification time change.
+class TextureCache
+{
+public:
+    // cook_flags identifies the options the cached levels were produced with, see TextureParams::cook_flags
+    TextureCache(const std::string &source_path, unsigned int cook_flags);
+
+    // fills texture from the cache file, returns false if it is missing, stale or malformed
+    bool load(CookedTexture &texture) const;
+    // writes texture to the cache file, returns false if the file could not be written
+    bool save(const CookedTexture &texture) const;
+
+private:
+    std::string source_path;
+    std::string cache_path;
+    unsigned int cook_flags;
+
+    bool source_stamp(unsigned long long &size, long long &mtime) const;
+};
+
+#endif
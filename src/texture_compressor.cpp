@@ -0,0 +1,279 @@
+#include "texture_compressor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "thread_pool.h"
+
+#if defined(__SSE2__)
+#define COMPRESSOR_SIMD 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    size_t block_size(Block_Format format)
+    {
+        return format == BC1 || format == BC4 ? 8 : 16;
+    }
+
+    // the 4x4 pixels at block (bx, by) as RGBA, pixels past the right and bottom edge repeat the last column and row
+    void fetch_block(const unsigned char *pixels, int width, int height, int n_components, int bx, int by, uint8_t rgba[64])
+    {
+        for (int y = 0; y < 4; y++)
+        {
+            const unsigned char *row = pixels + size_t(std::min(by * 4 + y, height - 1)) * width * n_components;
+            for (int x = 0; x < 4; x++)
+            {
+                const unsigned char *pixel = row + size_t(std::min(bx * 4 + x, width - 1)) * n_components;
+                uint8_t *out = rgba + (y * 4 + x) * 4;
+                out[0] = out[1] = out[2] = 0;
+                out[3] = 255;
+                std::memcpy(out, pixel, std::min(n_components, 4));
+            }
+        }
+    }
+
+    uint16_t to_565(const int color[3])
+    {
+        return uint16_t(((color[0] * 31 + 127) / 255) << 11 | ((color[1] * 63 + 127) / 255) << 5 | ((color[2] * 31 + 127) / 255));
+    }
+
+    // what the decoder expands a 565 color to
+    void from_565(uint16_t packed, int color[3])
+    {
+        int r = packed >> 11 & 31;
+        int g = packed >> 5 & 63;
+        int b = packed & 31;
+        color[0] = r << 3 | r >> 2;
+        color[1] = g << 2 | g >> 4;
+        color[2] = b << 3 | b >> 2;
+    }
+
+    void color_bounds(const uint8_t *rgba, uint8_t min[4], uint8_t max[4])
+    {
+#ifdef COMPRESSOR_SIMD
+        __m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rgba));
+        __m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rgba + 16));
+        __m128i p2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rgba + 32));
+        __m128i p3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rgba + 48));
+        __m128i low = _mm_min_epu8(_mm_min_epu8(p0, p1), _mm_min_epu8(p2, p3));
+        __m128i high = _mm_max_epu8(_mm_max_epu8(p0, p1), _mm_max_epu8(p2, p3));
+        // fold the four pixels of each register onto the first one
+        low = _mm_min_epu8(low, _mm_srli_si128(low, 8));
+        low = _mm_min_epu8(low, _mm_srli_si128(low, 4));
+        high = _mm_max_epu8(high, _mm_srli_si128(high, 8));
+        high = _mm_max_epu8(high, _mm_srli_si128(high, 4));
+        int low_bits = _mm_cvtsi128_si32(low);
+        int high_bits = _mm_cvtsi128_si32(high);
+        std::memcpy(min, &low_bits, 4);
+        std::memcpy(max, &high_bits, 4);
+#else
+        for (int c = 0; c < 4; c++)
+        {
+            min[c] = 255;
+            max[c] = 0;
+        }
+        for (int i = 0; i < 16; i++)
+        {
+            for (int c = 0; c < 4; c++)
+            {
+                min[c] = std::min(min[c], rgba[i * 4 + c]);
+                max[c] = std::max(max[c], rgba[i * 4 + c]);
+            }
+        }
+#endif
+    }
+
+    // 2 bit index per pixel, first pixel in the lowest bits. Projects every pixel onto the line from end to start,
+    // the palette is start, end, 2/3 start + 1/3 end and 1/3 start + 2/3 end.
+    uint32_t color_indices(const uint8_t *rgba, const int start[3], const int end[3])
+    {
+        // position on the line in thirds, from end to start, to palette index
+        static const uint32_t palette_index[4] = {1, 3, 2, 0};
+        int axis[3] = {start[0] - end[0], start[1] - end[1], start[2] - end[2]};
+        float scale = 3.0f / float(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+
+        uint32_t indices = 0;
+#ifdef COMPRESSOR_SIMD
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i three = _mm_set1_epi16(3);
+        const __m128i base = _mm_setr_epi16(end[0], end[1], end[2], 0, end[0], end[1], end[2], 0);
+        const __m128i direction = _mm_setr_epi16(axis[0], axis[1], axis[2], 0, axis[0], axis[1], axis[2], 0);
+        const __m128 scales = _mm_set1_ps(scale);
+        for (int i = 0; i < 4; i++)
+        {
+            // four pixels: widen to 16 bits, (pixel - end) . axis as two partial sums per pixel, then add the halves
+            __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rgba + i * 16));
+            __m128i low = _mm_madd_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(pixels, zero), base), direction);
+            __m128i high = _mm_madd_epi16(_mm_sub_epi16(_mm_unpackhi_epi8(pixels, zero), base), direction);
+            __m128 even = _mm_shuffle_ps(_mm_castsi128_ps(low), _mm_castsi128_ps(high), _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 odd = _mm_shuffle_ps(_mm_castsi128_ps(low), _mm_castsi128_ps(high), _MM_SHUFFLE(3, 1, 3, 1));
+            __m128i dot = _mm_add_epi32(_mm_castps_si128(even), _mm_castps_si128(odd));
+
+            __m128i t = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(dot), scales));
+            t = _mm_packs_epi32(t, t);
+            t = _mm_min_epi16(_mm_max_epi16(t, zero), three);
+            int16_t positions[8];
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(positions), t);
+            for (int j = 0; j < 4; j++)
+            {
+                indices |= palette_index[positions[j]] << ((i * 4 + j) * 2);
+            }
+        }
+#else
+        for (int i = 0; i < 16; i++)
+        {
+            const uint8_t *pixel = rgba + i * 4;
+            int dot = (pixel[0] - end[0]) * axis[0] + (pixel[1] - end[1]) * axis[1] + (pixel[2] - end[2]) * axis[2];
+            int t = std::min(std::max(static_cast<int>(std::lrint(dot * scale)), 0), 3);
+            indices |= palette_index[t] << (i * 2);
+        }
+#endif
+        return indices;
+    }
+
+    void encode_color_block(const uint8_t *rgba, uint8_t *out)
+    {
+        uint8_t min[4];
+        uint8_t max[4];
+        color_bounds(rgba, min, max);
+        int start[3] = {max[0], max[1], max[2]};
+        int end[3] = {min[0], min[1], min[2]};
+
+        // the box diagonal from min to max only follows the colors if the channels rise together,
+        // flip red and blue where they fall while green rises
+        int sum[3] = {};
+        for (int i = 0; i < 16; i++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                sum[c] += rgba[i * 4 + c];
+            }
+        }
+        int covariance_rg = 0;
+        int covariance_bg = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            int r = rgba[i * 4] * 16 - sum[0];
+            int g = rgba[i * 4 + 1] * 16 - sum[1];
+            int b = rgba[i * 4 + 2] * 16 - sum[2];
+            covariance_rg += r * g / 16;
+            covariance_bg += b * g / 16;
+        }
+        if (covariance_rg < 0)
+        {
+            std::swap(start[0], end[0]);
+        }
+        if (covariance_bg < 0)
+        {
+            std::swap(start[2], end[2]);
+        }
+
+        // pull the ends in by 1/16 of the range, the outermost pixels rarely deserve to be hit exactly
+        for (int c = 0; c < 3; c++)
+        {
+            int inset = (start[c] - end[c]) / 16;
+            start[c] -= inset;
+            end[c] += inset;
+        }
+
+        // the larger endpoint goes first, that selects the four color mode
+        uint16_t color0 = to_565(start);
+        uint16_t color1 = to_565(end);
+        if (color0 < color1)
+        {
+            std::swap(color0, color1);
+        }
+        uint32_t indices = 0;
+        if (color0 != color1)
+        {
+            from_565(color0, start);
+            from_565(color1, end);
+            indices = color_indices(rgba, start, end);
+        }
+
+        out[0] = uint8_t(color0);
+        out[1] = uint8_t(color0 >> 8);
+        out[2] = uint8_t(color1);
+        out[3] = uint8_t(color1 >> 8);
+        for (int i = 0; i < 4; i++)
+        {
+            out[4 + i] = uint8_t(indices >> (i * 8));
+        }
+    }
+
+    // one channel of the RGBA block, starting at rgba, in the eight value mode: max, min and six steps between
+    void encode_channel_block(const uint8_t *rgba, uint8_t *out)
+    {
+        int low = 255;
+        int high = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            low = std::min(low, int(rgba[i * 4]));
+            high = std::max(high, int(rgba[i * 4]));
+        }
+
+        uint64_t indices = 0;
+        if (high > low)
+        {
+            int range = high - low;
+            for (int i = 0; i < 16; i++)
+            {
+                // position between min and max in sevenths, rounded, to palette index
+                int t = ((rgba[i * 4] - low) * 14 + range) / (2 * range);
+                uint64_t index = t == 7 ? 0 : t == 0 ? 1 : 8 - t;
+                indices |= index << (i * 3);
+            }
+        }
+
+        out[0] = uint8_t(high);
+        out[1] = uint8_t(low);
+        for (int i = 0; i < 6; i++)
+        {
+            out[2 + i] = uint8_t(indices >> (i * 8));
+        }
+    }
+}
+
+size_t compressed_size(Block_Format format, int width, int height)
+{
+    return size_t((width + 3) / 4) * ((height + 3) / 4) * block_size(format);
+}
+
+void compress_image(const unsigned char *pixels, int width, int height, int n_components, Block_Format format, std::vector<unsigned char> &out)
+{
+    int blocks_x = (width + 3) / 4;
+    int blocks_y = (height + 3) / 4;
+    size_t size = block_size(format);
+    out.resize(compressed_size(format, width, height));
+
+    ThreadPool::shared().parallel_for(blocks_y, [&](size_t by)
+                                      {
+                                          uint8_t rgba[64];
+                                          unsigned char *block = out.data() + by * blocks_x * size;
+                                          for (int bx = 0; bx < blocks_x; bx++, block += size)
+                                          {
+                                              fetch_block(pixels, width, height, n_components, bx, int(by), rgba);
+                                              switch (format)
+                                              {
+                                              case BC1:
+                                                  encode_color_block(rgba, block);
+                                                  break;
+                                              case BC3:
+                                                  encode_channel_block(rgba + 3, block);
+                                                  encode_color_block(rgba, block + 8);
+                                                  break;
+                                              case BC4:
+                                                  encode_channel_block(rgba, block);
+                                                  break;
+                                              case BC5:
+                                                  encode_channel_block(rgba, block);
+                                                  encode_channel_block(rgba + 1, block + 8);
+                                                  break;
+                                              }
+                                          }
+                                      });
+}
@@ -0,0 +1,29 @@
+#ifndef TEXTURE_COMPRESSOR_H
+#define TEXTURE_COMPRESSOR_H
+
+#include <cstddef>
+#include <vector>
+
+// block compressed formats, every 4x4 block of pixels becomes 8 or 16 bytes
+enum Block_Format
+{
+    // RGB, 8 bytes per block
+    BC1,
+    // RGBA, BC4 alpha followed by BC1 color, 16 bytes per block
+    BC3,
+    // one channel, 8 bytes per block
+    BC4,
+    // two channels, two BC4 blocks, 16 bytes per block
+    BC5
+};
+
+// bytes one image of width x height takes in format, partial blocks at the edges count as whole ones
+size_t compressed_size(Block_Format format, int width, int height);
+
+// Compresses 8 bit pixels with n_components channels into format, rows of blocks are spread over the thread pool.
+// The encoder fits the endpoints to the inset bounding box of each block and picks indices by projecting onto the
+// line between them, which is fast enough to cook a 4K texture in well under a second and close to what slower
+// exhaustive encoders reach on photographic content. Channels the format doesn't have are ignored.
+void compress_image(const unsigned char *pixels, int width, int height, int n_components, Block_Format format, std::vector<unsigned char> &out);
+
+#endif
@@ -0,0 +1,106 @@
+#include "texture_cooker.h"
+
+#include <glad/glad.h>
+
+#include "gl_extensions.h"
+#include "mip_generator.h"
+#include "texture_compressor.h"
+
+namespace
+{
+    const GLenum formats[4] = {GL_RED, GL_RG, GL_RGB, GL_RGBA};
+
+    int component_count(uint32_t format)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            if (formats[i] == format)
+            {
+                return i + 1;
+            }
+        }
+        return 0;
+    }
+
+    bool is_opaque(const TextureLevel &level)
+    {
+        for (size_t i = 0; i < size_t(level.width) * level.height; i++)
+        {
+            if (level.data[i * 4 + 3] != 255)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+size_t level_size(uint32_t internal_format, uint32_t format, int width, int height)
+{
+    if (format != 0)
+    {
+        int n_components = component_count(format);
+        return internal_format == format ? size_t(width) * height * n_components : 0;
+    }
+
+    switch (internal_format)
+    {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        return compressed_size(BC1, width, height);
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+        return compressed_size(BC3, width, height);
+    case GL_COMPRESSED_RED_RGTC1:
+        return compressed_size(BC4, width, height);
+    case GL_COMPRESSED_RG_RGTC2:
+        return compressed_size(BC5, width, height);
+    default:
+        return 0;
+    }
+}
+
+void cook_texture(const unsigned char *pixels, int width, int height, int n_components, bool normal_map, CookedTexture &texture)
+{
+    texture.internal_format = formats[n_components - 1];
+    texture.format = formats[n_components - 1];
+    texture.width = width;
+    texture.height = height;
+    generate_mips(pixels, width, height, n_components, n_components >= 3 && !normal_map, normal_map, texture.levels);
+}
+
+void compress_texture(const CookedTexture &texture, CookedTexture &compressed)
+{
+    int n_components = component_count(texture.format);
+    Block_Format block_format;
+    if (n_components == 1)
+    {
+        block_format = BC4;
+        compressed.internal_format = GL_COMPRESSED_RED_RGTC1;
+    }
+    else if (n_components == 2)
+    {
+        block_format = BC5;
+        compressed.internal_format = GL_COMPRESSED_RG_RGTC2;
+    }
+    else if (n_components == 3 || is_opaque(texture.levels[0]))
+    {
+        // alpha that is 1 everywhere costs BC3 twice the memory for nothing
+        block_format = BC1;
+        compressed.internal_format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    }
+    else
+    {
+        block_format = BC3;
+        compressed.internal_format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    }
+    compressed.format = 0;
+    compressed.width = texture.width;
+    compressed.height = texture.height;
+    compressed.levels.resize(texture.levels.size());
+    for (size_t i = 0; i < texture.levels.size(); i++)
+    {
+        const TextureLevel &level = texture.levels[i];
+        compressed.levels[i].width = level.width;
+        compressed.levels[i].height = level.height;
+        compress_image(level.data.data(), level.width, level.height, n_components, block_format, compressed.levels[i].data);
+    }
+}
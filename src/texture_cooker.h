@@ -0,0 +1,40 @@
+#ifndef TEXTURE_COOKER_H
+#define TEXTURE_COOKER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct TextureLevel
+{
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> data;
+};
+
+// A texture in the form it is uploaded in: the GL formats and a full mip chain, largest level first.
+// This is what TextureCache stores, uploading it is a straight copy per level.
+struct CookedTexture
+{
+    // GL internal format, and the pixel format for uncompressed data or 0 for block compressed data
+    uint32_t internal_format = 0;
+    uint32_t format = 0;
+    int width = 0;
+    int height = 0;
+    std::vector<TextureLevel> levels;
+
+    bool is_compressed() const { return format == 0; }
+};
+
+// bytes a level of width x height takes in the given formats, 0 for formats the cooker never produces
+size_t level_size(uint32_t internal_format, uint32_t format, int width, int height);
+
+// Builds the mip chain of 8 bit pixels with n_components channels (see generate_mips), uncompressed. RGB and RGBA
+// images are treated as sRGB color unless they are normal maps. Uses the thread pool.
+void cook_texture(const unsigned char *pixels, int width, int height, int n_components, bool normal_map, CookedTexture &texture);
+
+// block compresses every level of an uncompressed texture: BC4 for one channel, BC5 for two, BC1 for RGB and RGBA
+// without transparent pixels, BC3 otherwise. Uses the thread pool.
+void compress_texture(const CookedTexture &texture, CookedTexture &compressed);
+
+#endif
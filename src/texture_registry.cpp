@@ -0,0 +1,215 @@
+#include "texture_registry.h"
+#include "thread_pool.h"
+#include "stb_image.h"
+
+#include <filesystem>
+#include <iostream>
+
+#include <glad/glad.h>
+
+#include "gl_extensions.h"
+#include "gl_state.h"
+#include "texture_cache.h"
+
+TextureResource::~TextureResource()
+{
+    if (id != 0)
+    {
+        GLState::get().deleted_texture(id);
+        glDeleteTextures(1, &id);
+    }
+}
+
+unsigned int TextureParams::cook_flags() const
+{
+    unsigned int flags = 0;
+    if (flip_vertically)
+    {
+        flags |= 1u << 0;
+    }
+    if (compress)
+    {
+        flags |= 1u << 1;
+    }
+    if (normal_map)
+    {
+        flags |= 1u << 2;
+    }
+    return flags;
+}
+
+TextureRegistry &TextureRegistry::instance()
+{
+    // intentionally never destroyed, decode tasks still running on the thread pool at exit may report back to it
+    static TextureRegistry *registry = new TextureRegistry();
+    return *registry;
+}
+
+std::string TextureRegistry::make_key(const std::string &path, const TextureParams &params)
+{
+    std::error_code error;
+    std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+    std::string key = error ? path : canonical.string();
+    key += params.flip_vertically ? "|flip" : "|noflip";
+    key += params.compress ? "|bc" : "";
+    key += params.normal_map ? "|normal" : "";
+    return key;
+}
+
+TextureHandle TextureRegistry::acquire(const std::string &path, const TextureParams &params)
+{
+    std::string key = make_key(path, params);
+
+    std::shared_ptr<TextureResource> texture;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::weak_ptr<TextureResource> &entry = textures[key];
+        texture = entry.lock();
+        if (texture)
+        {
+            return texture;
+        }
+        texture = std::make_shared<TextureResource>();
+        entry = texture;
+    }
+
+    // first user of this file, decode it in the background
+    std::weak_ptr<TextureResource> target = texture;
+    TextureParams cooking = params;
+    cooking.compress = params.compress && GLExtensions::get().texture_compression_s3tc;
+    ThreadPool::shared().submit([this, target, path, cooking]()
+                                {
+                                    // nobody wants the texture anymore, skip the decode
+                                    if (target.expired())
+                                    {
+                                        return;
+                                    }
+
+                                    DecodedImage image;
+                                    image.texture = target;
+                                    image.path = path;
+
+                                    // a warm start only reads the cooked levels, otherwise decode and cook them now
+                                    TextureCache cache(path, cooking.cook_flags());
+                                    CookedTexture uncompressed;
+                                    if (!cache.load(image.cooked))
+                                    {
+                                        int width, height, n_components;
+                                        stbi_set_flip_vertically_on_load_thread(cooking.flip_vertically);
+                                        unsigned char *data = stbi_load(path.c_str(), &width, &height, &n_components, 0);
+                                        if (data)
+                                        {
+                                            cook_texture(data, width, height, n_components, cooking.normal_map, image.cooked);
+                                            stbi_image_free(data);
+                                            if (cooking.compress)
+                                            {
+                                                // this run uploads the uncompressed levels right away, compressing only pays off from the next one on
+                                                uncompressed = image.cooked;
+                                            }
+                                            else
+                                            {
+                                                cache.save(image.cooked);
+                                            }
+                                        }
+                                    }
+
+                                    {
+                                        std::lock_guard<std::mutex> lock(mutex);
+                                        decoded.push_back(std::move(image));
+                                    }
+
+                                    if (!uncompressed.levels.empty())
+                                    {
+                                        CookedTexture compressed;
+                                        compress_texture(uncompressed, compressed);
+                                        cache.save(compressed);
+                                    }
+                                });
+    return texture;
+}
+
+bool TextureRegistry::upload_next()
+{
+    while (true)
+    {
+        DecodedImage image;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (decoded.empty())
+            {
+                return false;
+            }
+            image = std::move(decoded.back());
+            decoded.pop_back();
+        }
+
+        std::shared_ptr<TextureResource> texture = image.texture.lock();
+        if (texture)
+        {
+            upload(*texture, image);
+            return true;
+        }
+    }
+}
+
+size_t TextureRegistry::size()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t count = 0;
+    for (auto it = textures.begin(); it != textures.end();)
+    {
+        if (it->second.expired())
+        {
+            it = textures.erase(it);
+        }
+        else
+        {
+            count++;
+            it++;
+        }
+    }
+    return count;
+}
+
+void TextureRegistry::upload(TextureResource &texture, DecodedImage &image)
+{
+    glGenTextures(1, &texture.id);
+
+    if (!image.cooked.levels.empty())
+    {
+        // every level is ready to go, the driver only copies
+        const CookedTexture &cooked = image.cooked;
+        GLState::get().bind_texture(0, GL_TEXTURE_2D, texture.id);
+        // rows of single channel and RGB levels aren't necessarily 4 byte aligned
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (size_t level = 0; level < cooked.levels.size(); level++)
+        {
+            const TextureLevel &data = cooked.levels[level];
+            if (cooked.is_compressed())
+            {
+                glCompressedTexImage2D(GL_TEXTURE_2D, GLint(level), cooked.internal_format, data.width, data.height, 0,
+                                       GLsizei(data.data.size()), data.data.data());
+            }
+            else
+            {
+                glTexImage2D(GL_TEXTURE_2D, GLint(level), cooked.internal_format, data.width, data.height, 0, cooked.format, GL_UNSIGNED_BYTE,
+                             data.data.data());
+            }
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, GLint(cooked.levels.size()) - 1);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        image.cooked = CookedTexture();
+    }
+    else
+    {
+        std::cout << "Texture failed to load at path: " << image.path << std::endl;
+    }
+
+    // a texture that failed to load stays an empty texture, same as before, so meshes using it still get drawn
+    texture.resident = true;
+}
@@ -0,0 +1,80 @@
+#ifndef TEXTURE_REGISTRY_H
+#define TEXTURE_REGISTRY_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "texture_cooker.h"
+
+// options that change the uploaded texture, part of the registry key. Everything that changes the cooked levels is
+// part of the texture cache key too (see cook_flags).
+struct TextureParams
+{
+    bool flip_vertically = true;
+    // upload block compressed instead of as 8 bit pixels. Ignored if the driver lacks S3TC.
+    bool compress = false;
+    // the pixels are unit vectors, the mip levels are renormalized instead of filtered as sRGB color
+    bool normal_map = false;
+
+    unsigned int cook_flags() const;
+};
+
+// A GL texture shared by everything that uses the same file with the same params.
+// The GL object is deleted together with the last handle, so handles must only be dropped on the GL thread.
+class TextureResource
+{
+public:
+    unsigned int id = 0;
+    // GL_TEXTURE_2D_ARRAY for texture arrays built outside the registry, see texture_array.h
+    GLenum target = GL_TEXTURE_2D;
+    // set once the pixels are uploaded and the texture can be sampled
+    bool resident = false;
+
+    ~TextureResource();
+};
+
+typedef std::shared_ptr<TextureResource> TextureHandle;
+
+// Process-wide table of loaded textures keyed on canonical file path plus TextureParams.
+// Every file is decoded and uploaded once no matter how many models reference it, with its mip chain cooked on the
+// CPU and cached next to the image (see TextureCache) so later runs only copy the levels. The registry itself
+// only holds weak references so a texture goes away as soon as no model uses it anymore.
+class TextureRegistry
+{
+public:
+    static TextureRegistry &instance();
+
+    // returns the shared texture for path, must be called on the GL thread. A texture nobody holds yet is decoded
+    // on the thread pool and only becomes resident after a later upload_next() call picks it up.
+    TextureHandle acquire(const std::string &path, const TextureParams &params = TextureParams());
+
+    // uploads one decoded texture on the GL thread, returns false if none is waiting
+    bool upload_next();
+
+    // number of textures currently alive
+    size_t size();
+
+private:
+    // the levels of a texture ready for upload, none if the file failed to load
+    struct DecodedImage
+    {
+        std::weak_ptr<TextureResource> texture;
+        std::string path;
+        CookedTexture cooked;
+    };
+
+    std::mutex mutex;
+    std::unordered_map<std::string, std::weak_ptr<TextureResource>> textures;
+    std::vector<DecodedImage> decoded;
+
+    TextureRegistry() = default;
+    static std::string make_key(const std::string &path, const TextureParams &params);
+    static void upload(TextureResource &texture, DecodedImage &image);
+};
+
+#endif
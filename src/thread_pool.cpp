@@ -0,0 +1,112 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+ThreadPool::ThreadPool(unsigned int n_threads)
+{
+    for (unsigned int i = 0; i < n_threads; i++)
+    {
+        workers.emplace_back(&ThreadPool::worker_loop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+ThreadPool &ThreadPool::shared()
+{
+    // leave one core for the thread that owns the GL context
+    static ThreadPool pool(std::max(2u, std::thread::hardware_concurrency()) - 1);
+    return pool;
+}
+
+std::future<void> ThreadPool::submit(std::function<void()> task)
+{
+    std::packaged_task<void()> packaged(std::move(task));
+    std::future<void> result = packaged.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push(std::move(packaged));
+    }
+    condition.notify_one();
+    return result;
+}
+
+void ThreadPool::parallel_for(size_t count, const std::function<void(size_t)> &function)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    // the state outlives this call because helpers may only get scheduled after the caller already finished all the work
+    struct Work
+    {
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> done{0};
+        size_t count;
+        std::function<void(size_t)> function;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    std::shared_ptr<Work> work = std::make_shared<Work>();
+    work->count = count;
+    work->function = function;
+
+    auto run = [work]()
+    {
+        for (size_t i = work->next++; i < work->count; i = work->next++)
+        {
+            work->function(i);
+            if (++work->done == work->count)
+            {
+                std::lock_guard<std::mutex> lock(work->mutex);
+                work->finished.notify_all();
+            }
+        }
+    };
+
+    size_t n_helpers = std::min<size_t>(workers.size(), count - 1);
+    for (size_t i = 0; i < n_helpers; i++)
+    {
+        submit(run);
+    }
+    run();
+
+    std::unique_lock<std::mutex> lock(work->mutex);
+    work->finished.wait(lock, [&work]()
+                        { return work->done == work->count; });
+}
+
+void ThreadPool::worker_loop()
+{
+    while (true)
+    {
+        std::packaged_task<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]()
+                           { return stopping || !tasks.empty(); });
+            if (stopping && tasks.empty())
+            {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+        task();
+    }
+}
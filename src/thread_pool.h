@@ -0,0 +1,44 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads consuming a FIFO task queue. Workers never touch the GL context,
+// anything that needs GL has to be handed back to the thread that owns it.
+class ThreadPool
+{
+public:
+    ThreadPool(unsigned int n_threads);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // process-wide pool sized to the machine, created on first use
+    static ThreadPool &shared();
+
+    unsigned int size() const { return static_cast<unsigned int>(workers.size()); }
+
+    // queues a task, the returned future becomes ready once it has run
+    std::future<void> submit(std::function<void()> task);
+
+    // calls function(i) for every i in [0, count) spread over the workers and the calling thread, returns once all calls are done.
+    // The caller takes part in the work, so it is safe to call from inside another pool task.
+    void parallel_for(size_t count, const std::function<void(size_t)> &function);
+
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::packaged_task<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping = false;
+
+    void worker_loop();
+};
+
+#endif